@@ -0,0 +1,45 @@
+// SPDX-FileCopyrightText: Moritz Bruder <muesli4 at gmail dot com>
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include <cstdlib>
+#include <new>
+
+#include "allocation_counter.hpp"
+
+#ifdef COUNT_ALLOCATIONS
+
+static thread_local std::size_t allocations = 0;
+
+// The array and non-throwing forms forward to these.
+void * operator new(std::size_t size)
+{
+    allocations++;
+    if (void * p = std::malloc(size == 0 ? 1 : size))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void * p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void * p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+std::size_t allocation_count()
+{
+    return allocations;
+}
+
+#else
+
+std::size_t allocation_count()
+{
+    return 0;
+}
+
+#endif
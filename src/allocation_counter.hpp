@@ -0,0 +1,12 @@
+// SPDX-FileCopyrightText: Moritz Bruder <muesli4 at gmail dot com>
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#pragma once
+
+#include <cstddef>
+
+// Number of heap allocations the calling thread made so far. Allocations are
+// only counted when built with COUNT_ALLOCATIONS (configure with
+// --enable-allocation-counter), otherwise this is always 0.
+std::size_t allocation_count();
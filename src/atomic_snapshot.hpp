@@ -0,0 +1,79 @@
+// SPDX-FileCopyrightText: Moritz Bruder <muesli4 at gmail dot com>
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+// Publishes a trivially copyable value from a single writer thread to any
+// number of reader threads without locking (a sequence lock). Readers retry
+// while a store is in progress, the writer never waits.
+template <typename T>
+class atomic_snapshot
+{
+    static_assert(std::is_trivially_copyable_v<T>, "snapshot type has to be trivially copyable");
+
+    typedef std::uint32_t word_type;
+    static constexpr std::size_t num_words = (sizeof(T) + sizeof(word_type) - 1) / sizeof(word_type);
+    typedef std::array<word_type, num_words> word_array;
+
+    std::atomic<unsigned int> _sequence;
+    std::array<std::atomic<word_type>, num_words> _words;
+
+    public:
+
+    atomic_snapshot(T const & initial = T())
+        : _sequence(0)
+    {
+        word_array words = to_words(initial);
+        for (std::size_t i = 0; i < num_words; ++i)
+            _words[i].store(words[i], std::memory_order_relaxed);
+    }
+
+    // Must only be called from one thread.
+    void store(T const & value)
+    {
+        word_array words = to_words(value);
+
+        unsigned int const sequence = _sequence.load(std::memory_order_relaxed);
+        _sequence.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        for (std::size_t i = 0; i < num_words; ++i)
+            _words[i].store(words[i], std::memory_order_relaxed);
+
+        _sequence.store(sequence + 2, std::memory_order_release);
+    }
+
+    T load() const
+    {
+        word_array words;
+        unsigned int sequence;
+        do
+        {
+            sequence = _sequence.load(std::memory_order_acquire);
+            for (std::size_t i = 0; i < num_words; ++i)
+                words[i] = _words[i].load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+        }
+        while ((sequence & 1) != 0 || sequence != _sequence.load(std::memory_order_relaxed));
+
+        T result;
+        std::memcpy(static_cast<void *>(&result), words.data(), sizeof(T));
+        return result;
+    }
+
+    private:
+
+    static word_array to_words(T const & value)
+    {
+        word_array words {};
+        std::memcpy(words.data(), &value, sizeof(T));
+        return words;
+    }
+};
@@ -83,3 +83,16 @@ std::optional<boost::filesystem::path> find_or_create_config_file(std::string fi
         }
     }
 }
+
+std::optional<boost::filesystem::path> get_cache_directory()
+{
+    if (auto result = std::getenv("XDG_CACHE_HOME"))
+    {
+        return boost::filesystem::path(result) / PACKAGE_NAME;
+    }
+    if (auto result = std::getenv("HOME"))
+    {
+        return result / boost::filesystem::path(".cache") / PACKAGE_NAME;
+    }
+    return std::nullopt;
+}
@@ -14,5 +14,8 @@
 std::vector<boost::filesystem::path> get_config_directories();
 std::optional<boost::filesystem::path> find_or_create_config_file(std::string filename);
 
+// The directory for cached data of the program, if it can be determined.
+std::optional<boost::filesystem::path> get_cache_directory();
+
 #endif
 
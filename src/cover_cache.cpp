@@ -0,0 +1,68 @@
+// SPDX-FileCopyrightText: Moritz Bruder <muesli4 at gmail dot com>
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include "cover_cache.hpp"
+#include "util.hpp"
+
+std::optional<std::string> cover_cache_key(std::string_view path, song_info const & info)
+{
+    std::string_view const dir = basename(path);
+    if (dir.empty() || path.find("://") != std::string_view::npos)
+        return std::nullopt;
+
+    return std::string(dir) + '\n' + info.album;
+}
+
+cover_cache::cover_cache(std::size_t max_bytes)
+    : _max_bytes(max_bytes)
+    , _bytes(0)
+{
+}
+
+std::optional<shared_surface_ptr> cover_cache::lookup(std::string const & key)
+{
+    std::scoped_lock lock(_mutex);
+
+    auto it = _index.find(key);
+    if (it == _index.end())
+        return std::nullopt;
+
+    _entries.splice(_entries.begin(), _entries, it->second);
+    return it->second->surface;
+}
+
+void cover_cache::insert(std::string const & key, shared_surface_ptr surface)
+{
+    std::size_t const bytes = key.size() + (surface ? surface_size_in_bytes(*surface) : 0);
+    if (bytes > _max_bytes)
+        return;
+
+    std::scoped_lock lock(_mutex);
+
+    auto it = _index.find(key);
+    if (it != _index.end())
+    {
+        _bytes -= it->second->bytes;
+        _entries.erase(it->second);
+        _index.erase(it);
+    }
+
+    _entries.push_front(entry{ key, std::move(surface), bytes });
+    _index.emplace(key, _entries.begin());
+    _bytes += bytes;
+
+    evict();
+}
+
+void cover_cache::evict()
+{
+    while (_bytes > _max_bytes)
+    {
+        entry const & e = _entries.back();
+        _bytes -= e.bytes;
+        _index.erase(e.key);
+        _entries.pop_back();
+    }
+}
+
@@ -0,0 +1,55 @@
+// SPDX-FileCopyrightText: Moritz Bruder <muesli4 at gmail dot com>
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#ifndef COVER_CACHE_HPP
+#define COVER_CACHE_HPP
+
+#include <cstddef>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "song_info.hpp"
+#include "surface_util.hpp"
+
+// Songs of the same album share their cover. Returns nothing if the song
+// cannot be attributed to an album directory (e.g., streams).
+std::optional<std::string> cover_cache_key(std::string_view path, song_info const & info);
+
+// A thread-safe least recently used cache of decoded covers with a limit on
+// the memory used by the surfaces.
+struct cover_cache
+{
+    explicit cover_cache(std::size_t max_bytes);
+
+    // An entry without surface records that there is no cover.
+    std::optional<shared_surface_ptr> lookup(std::string const & key);
+    void insert(std::string const & key, shared_surface_ptr surface);
+
+    private:
+
+    struct entry
+    {
+        std::string key;
+        shared_surface_ptr surface;
+        std::size_t bytes;
+    };
+
+    void evict();
+
+    std::mutex _mutex;
+
+    std::size_t const _max_bytes;
+    std::size_t _bytes;
+
+    // most recently used first
+    std::list<entry> _entries;
+    std::unordered_map<std::string, std::list<entry>::iterator> _index;
+};
+
+#endif
+
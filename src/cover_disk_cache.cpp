@@ -0,0 +1,205 @@
+// SPDX-FileCopyrightText: Moritz Bruder <muesli4 at gmail dot com>
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+
+#include "cover_disk_cache.hpp"
+
+// The header consists of the magic, the width, and the height. The pixels
+// follow row by row without padding. Entries are written and read on the
+// same machine, so native byte order is used.
+static char const MAGIC[4] = { 'M', 'T', 'C', '1' };
+
+typedef std::array<std::uint32_t, 2> dimensions;
+
+// FNV-1a, which is stable across runs unlike std::hash.
+static std::uint64_t fnv1a_64(std::string const & s)
+{
+    std::uint64_t hash = 0xcbf29ce484222325;
+    for (unsigned char c : s)
+    {
+        hash ^= c;
+        hash *= 0x100000001b3;
+    }
+    return hash;
+}
+
+cover_disk_cache::cover_disk_cache(boost::filesystem::path directory, std::uintmax_t max_bytes)
+    : _directory(std::move(directory))
+    , _max_bytes(max_bytes)
+    , _bytes(0)
+{
+    boost::system::error_code ec;
+    boost::filesystem::create_directories(_directory, ec);
+    evict();
+}
+
+boost::filesystem::path cover_disk_cache::entry_path(std::string const & key, vec size) const
+{
+    std::ostringstream name;
+    name << std::hex << std::setw(16) << std::setfill('0') << fnv1a_64(key)
+         << std::dec << '-' << size.w << 'x' << size.h << ".cover";
+    return _directory / name.str();
+}
+
+// Before the layout is done the size is empty and covers are not scaled at
+// all. Those are neither stored nor loaded.
+static bool is_scaled_size(vec size)
+{
+    return size.w > 0 && size.h > 0;
+}
+
+unique_surface_ptr cover_disk_cache::load(std::string const & key, vec size) const
+{
+    if (!is_scaled_size(size))
+        return nullptr;
+
+    auto const path = entry_path(key, size);
+    std::ifstream in(path.string(), std::ios::binary);
+    if (!in)
+        return nullptr;
+
+    char magic[sizeof(MAGIC)];
+    dimensions dim;
+    if (!in.read(magic, sizeof(magic))
+        || std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0
+        || !in.read(reinterpret_cast<char *>(dim.data()), sizeof(dim))
+        || dim[0] == 0 || dim[1] == 0
+        || dim[0] > static_cast<std::uint32_t>(size.w)
+        || dim[1] > static_cast<std::uint32_t>(size.h))
+    {
+        return nullptr;
+    }
+
+    int const w = static_cast<int>(dim[0]);
+    int const h = static_cast<int>(dim[1]);
+    unique_surface_ptr s(SDL_CreateRGBSurfaceWithFormat(0, w, h, 32, SDL_PIXELFORMAT_ARGB8888));
+    if (!s)
+        return nullptr;
+
+    std::size_t const row_bytes = static_cast<std::size_t>(w) * 4;
+    auto * pixels = static_cast<char *>(s->pixels);
+    for (int y = 0; y < h; ++y)
+    {
+        if (!in.read(pixels + y * s->pitch, row_bytes))
+            return nullptr;
+    }
+
+    // The modification time tells which entries are used.
+    boost::system::error_code ec;
+    boost::filesystem::last_write_time(path, std::time(nullptr), ec);
+
+    return s;
+}
+
+void cover_disk_cache::store(std::string const & key, vec size, SDL_Surface * s)
+{
+    if (s == nullptr || s->format->format != SDL_PIXELFORMAT_ARGB8888 || !is_scaled_size(size))
+        return;
+
+    auto const path = entry_path(key, size);
+    auto tmp_path = path;
+    tmp_path += ".tmp";
+
+    {
+        std::ofstream out(tmp_path.string(), std::ios::binary | std::ios::trunc);
+        if (!out)
+            return;
+
+        dimensions const dim = { static_cast<std::uint32_t>(s->w), static_cast<std::uint32_t>(s->h) };
+        out.write(MAGIC, sizeof(MAGIC));
+        out.write(reinterpret_cast<char const *>(dim.data()), sizeof(dim));
+
+        std::size_t const row_bytes = static_cast<std::size_t>(s->w) * 4;
+        auto const * pixels = static_cast<char const *>(s->pixels);
+        for (int y = 0; y < s->h; ++y)
+        {
+            out.write(pixels + y * s->pitch, row_bytes);
+        }
+
+        if (!out)
+        {
+            out.close();
+            boost::system::error_code ec;
+            boost::filesystem::remove(tmp_path, ec);
+            return;
+        }
+    }
+
+    // A replaced entry no longer counts.
+    boost::system::error_code ec;
+    std::uintmax_t replaced_bytes = boost::filesystem::file_size(path, ec);
+    if (ec)
+        replaced_bytes = 0;
+
+    // Readers never see partially written entries.
+    boost::filesystem::rename(tmp_path, path, ec);
+    if (ec)
+        return;
+
+    std::uintmax_t const bytes = sizeof(MAGIC) + sizeof(dimensions) + static_cast<std::uintmax_t>(s->w) * s->h * 4;
+    _bytes = _bytes - std::min(_bytes, replaced_bytes) + bytes;
+    if (_bytes > _max_bytes)
+        evict();
+}
+
+void cover_disk_cache::evict()
+{
+    struct file
+    {
+        boost::filesystem::path path;
+        std::time_t time;
+        std::uintmax_t bytes;
+    };
+
+    std::vector<file> files;
+    std::uintmax_t total_bytes = 0;
+
+    boost::system::error_code ec;
+    boost::filesystem::directory_iterator it(_directory, ec);
+    for (; !ec && it != boost::filesystem::directory_iterator(); it.increment(ec))
+    {
+        auto const & path = it->path();
+        if (path.extension() != ".cover")
+            continue;
+
+        boost::system::error_code file_ec;
+        std::uintmax_t const bytes = boost::filesystem::file_size(path, file_ec);
+        if (file_ec)
+            continue;
+        std::time_t const time = boost::filesystem::last_write_time(path, file_ec);
+        if (file_ec)
+            continue;
+
+        files.push_back(file{ path, time, bytes });
+        total_bytes += bytes;
+    }
+
+    _bytes = total_bytes;
+    if (total_bytes <= _max_bytes)
+        return;
+
+    // Leave some room, so the next stores do not scan again right away.
+    std::uintmax_t const target_bytes = _max_bytes - _max_bytes / 4;
+    std::sort(files.begin(), files.end(), [](file const & a, file const & b){ return a.time < b.time; });
+    for (auto const & f : files)
+    {
+        if (total_bytes <= target_bytes)
+            break;
+
+        boost::system::error_code file_ec;
+        if (boost::filesystem::remove(f.path, file_ec))
+            total_bytes -= f.bytes;
+    }
+    _bytes = total_bytes;
+}
+
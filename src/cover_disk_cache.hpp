@@ -0,0 +1,54 @@
+// SPDX-FileCopyrightText: Moritz Bruder <muesli4 at gmail dot com>
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#ifndef COVER_DISK_CACHE_HPP
+#define COVER_DISK_CACHE_HPP
+
+#include <cstdint>
+#include <string>
+
+#include <boost/filesystem.hpp>
+
+#include "surface_util.hpp"
+
+// Persists decoded covers that are already scaled to the display. They are
+// stored as raw ARGB8888 pixels, which is much faster to load than decoding
+// the original image again.
+//
+// Files are named by a hash of the cache key and the size the cover has been
+// scaled for, so a different layout does not pick up unsuitable covers.
+//
+// The files are kept within a budget of bytes. Loading an entry marks it as
+// used, the least recently used ones are removed first. The size of the
+// directory is scanned once and then tracked, it is only scanned again to
+// evict entries.
+//
+// Not safe to use from multiple threads.
+struct cover_disk_cache
+{
+    cover_disk_cache(boost::filesystem::path directory, std::uintmax_t max_bytes);
+
+    // Returns nullptr if there is no usable entry. Nothing is cached for an
+    // empty size.
+    unique_surface_ptr load(std::string const & key, vec size) const;
+
+    // Failing to store is not an error, the cover is simply not cached.
+    void store(std::string const & key, vec size, SDL_Surface * s);
+
+    private:
+
+    boost::filesystem::path entry_path(std::string const & key, vec size) const;
+
+    // Count the bytes used and, if they exceed the budget, remove entries
+    // until three quarters of it are used.
+    void evict();
+
+    boost::filesystem::path _directory;
+    std::uintmax_t const _max_bytes;
+    // bytes used by entries, as far as known
+    std::uintmax_t _bytes;
+};
+
+#endif
+
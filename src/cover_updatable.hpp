@@ -5,18 +5,23 @@
 #ifndef COVER_UPDATABLE_HPP
 #define COVER_UPDATABLE_HPP
 
-#include <vector>
-#include <cstddef>
-
-#include <libwtk-sdl2/sdl_util.hpp>
+#include <string>
 
+#include "dynamic_image_data.hpp"
 #include "song_info.hpp"
 
 struct cover_updatable
 {
     virtual void update_cover_from_local_file(std::string filename) = 0;
     virtual void update_cover_from_song_info(song_info const & info) = 0;
-    virtual void update_cover_from_image_data(byte_array_slice data) = 0;
+    virtual void update_cover_from_image_data(dynamic_image_data const & data) = 0;
+
+    // The provider could not tell whether there is a cover, e.g., because the
+    // connection failed.
+    virtual void update_cover_failed() = 0;
+
+    // Whether the cover is still of interest, providers may stop early if not.
+    virtual bool is_cancelled() const = 0;
 };
 
 #endif
@@ -14,6 +14,7 @@ cover_view::cover_view(std::shared_ptr<label> l, std::shared_ptr<texture_view> t
     , _label(l)
     , _texture_view(tv)
     , _swipe_area(swipe_callback, press_callback)
+    , _cover_size{ 0, 0 }
 {
     _label->set_wrap(true);
 }
@@ -41,6 +42,9 @@ void cover_view::on_box_allocated()
 {
     _embedded_widget.apply_layout(get_box());
     _swipe_area.apply_layout(get_box());
+
+    rect const box = get_box();
+    _cover_size = { box.w, box.h };
 }
 
 void cover_view::set_cover(unique_texture_ptr texture_ptr)
@@ -51,6 +55,11 @@ void cover_view::set_cover(unique_texture_ptr texture_ptr)
     _texture_view->set_texture(std::move(texture_ptr), 0, -1);
 }
 
+vec cover_view::get_cover_size() const
+{
+    return _cover_size;
+}
+
 void cover_view::set_cover(std::string title, std::string artist, std::string album)
 {
     _embedded_widget.set_page(0);
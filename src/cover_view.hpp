@@ -33,11 +33,16 @@ struct cover_view : embedded_widget<notebook>
     void set_cover(unique_texture_ptr texture_ptr);
     void set_cover(std::string title, std::string artist, std::string album);
 
+    // The space available for an image cover.
+    vec get_cover_size() const;
+
     private:
 
     std::shared_ptr<label> _label;
     std::shared_ptr<texture_view> _texture_view;
     swipe_area _swipe_area;
+
+    vec _cover_size;
 };
 
 #endif
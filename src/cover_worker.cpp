@@ -0,0 +1,272 @@
+// SPDX-FileCopyrightText: Moritz Bruder <muesli4 at gmail dot com>
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include <string>
+
+#include "config_file.hpp"
+#include "cover_worker.hpp"
+
+cover_request::cover_request(std::string path, song_info info, vec size)
+    : _path(std::move(path))
+    , _info(std::move(info))
+    , _size(size)
+{
+}
+
+song_info cover_request::get_song_info() const
+{
+    return _info;
+}
+
+std::string cover_request::get_song_path() const
+{
+    return _path;
+}
+
+vec cover_request::get_size() const
+{
+    return _size;
+}
+
+// Covers are scaled to the size they are displayed in, so covers of different
+// sizes are cached separately. Paths never contain a null character.
+static std::optional<std::string> sized_cover_cache_key(std::string_view path, song_info const & info, vec size)
+{
+    auto opt_key = cover_cache_key(path, info);
+    if (opt_key.has_value())
+    {
+        opt_key->push_back('\0');
+        opt_key.value() += std::to_string(size.w) + 'x' + std::to_string(size.h);
+    }
+    return opt_key;
+}
+
+// Collects the cover of one request on the worker thread.
+struct cover_collector : cover_updatable
+{
+    cover_collector(std::atomic<unsigned int> const & generation, unsigned int request_generation, song_info info, vec size)
+        : _generation(generation)
+        , _request_generation(request_generation)
+        , _size(size)
+        , _result{ nullptr, std::move(info) }
+    {
+    }
+
+    void update_cover_from_local_file(std::string filename) override
+    {
+        _result.surface = load_fitted_surface_from_file(filename, _size);
+    }
+
+    void update_cover_from_song_info(song_info const & info) override
+    {
+        _result.info = info;
+    }
+
+    void update_cover_from_image_data(dynamic_image_data const & data) override
+    {
+        _result.surface = load_fitted_surface_from_memory(data.data(), data.size(), _size);
+    }
+
+    void update_cover_failed() override
+    {
+        _failed = true;
+    }
+
+    bool is_cancelled() const override
+    {
+        return _generation.load() != _request_generation;
+    }
+
+    // Whether a provider could not tell if there is a cover.
+    bool has_failed() const
+    {
+        return _failed;
+    }
+
+    cover_result & result()
+    {
+        return _result;
+    }
+
+    private:
+
+    std::atomic<unsigned int> const & _generation;
+    unsigned int const _request_generation;
+    vec const _size;
+
+    cover_result _result;
+    bool _failed = false;
+};
+
+cover_worker::cover_worker(boost::ptr_vector<cover_provider> const & cover_providers, cover_config const & cfg, std::function<std::optional<queue_song>(unsigned int)> queue_song_lookup, std::function<void()> ready_callback)
+    : _cover_providers(cover_providers)
+    , _queue_song_lookup(queue_song_lookup)
+    , _ready_callback(ready_callback)
+    , _cover_cache(cfg.memory_cache_size)
+    , _generation(0)
+    , _run(true)
+    , _cover_size{ 0, 0 }
+{
+    if (cfg.disk_cache)
+    {
+        auto opt_cache_dir = get_cache_directory();
+        if (opt_cache_dir.has_value())
+        {
+            _opt_cover_disk_cache.emplace(opt_cache_dir.value() / "covers", cfg.disk_cache_size);
+        }
+    }
+
+    _thread = std::thread(&cover_worker::run, this);
+}
+
+cover_worker::~cover_worker()
+{
+    stop();
+}
+
+std::optional<cover_result> cover_worker::request(std::string path, song_info info, vec size)
+{
+    auto const opt_key = sized_cover_cache_key(path, info, size);
+    auto const opt_cached_surface = opt_key.has_value() ? _cover_cache.lookup(opt_key.value()) : std::nullopt;
+
+    {
+        std::scoped_lock lock(_mutex);
+        _generation++;
+        _opt_result.reset();
+        _cover_size = size;
+
+        if (opt_cached_surface.has_value())
+        {
+            _opt_request.reset();
+            return cover_result{ opt_cached_surface.value(), std::move(info) };
+        }
+
+        _opt_request.emplace(std::move(path), std::move(info), size);
+    }
+    _cv.notify_one();
+    return std::nullopt;
+}
+
+void cover_worker::prefetch(std::vector<unsigned int> const & positions)
+{
+    {
+        std::scoped_lock lock(_mutex);
+        _prefetch_positions.assign(positions.begin(), positions.end());
+    }
+    _cv.notify_one();
+}
+
+std::optional<cover_result> cover_worker::take_result()
+{
+    std::scoped_lock lock(_mutex);
+    std::optional<cover_result> result;
+    result.swap(_opt_result);
+    return result;
+}
+
+void cover_worker::stop()
+{
+    {
+        std::scoped_lock lock(_mutex);
+        _run = false;
+        _generation++;
+    }
+    _cv.notify_one();
+
+    if (_thread.joinable())
+        _thread.join();
+}
+
+void cover_worker::run()
+{
+    std::unique_lock lock(_mutex);
+    while (true)
+    {
+        _cv.wait(lock, [this](){ return !_run || _opt_request.has_value() || !_prefetch_positions.empty(); });
+        if (!_run)
+            break;
+
+        if (_opt_request.has_value())
+        {
+            cover_request request = std::move(_opt_request.value());
+            _opt_request.reset();
+            cover_collector collector(_generation, _generation.load(), request.get_song_info(), request.get_size());
+            lock.unlock();
+
+            // Fetching and decoding happens without holding the lock.
+            fetch(request, collector);
+
+            lock.lock();
+            if (!collector.is_cancelled())
+            {
+                _opt_result = std::move(collector.result());
+                lock.unlock();
+                _ready_callback();
+                lock.lock();
+            }
+        }
+        else
+        {
+            // Prefetching only fills the cache and is cancelled by any
+            // request.
+            unsigned int const pos = _prefetch_positions.front();
+            _prefetch_positions.pop_front();
+            unsigned int const generation = _generation.load();
+            vec const size = _cover_size;
+            lock.unlock();
+
+            auto opt_song = _queue_song_lookup(pos);
+            if (opt_song.has_value())
+            {
+                auto const opt_key = sized_cover_cache_key(opt_song->path, opt_song->info, size);
+                if (opt_key.has_value() && !_cover_cache.lookup(opt_key.value()).has_value())
+                {
+                    cover_request request(opt_song->path, opt_song->info, size);
+                    cover_collector collector(_generation, generation, request.get_song_info(), size);
+                    fetch(request, collector);
+                }
+            }
+
+            lock.lock();
+        }
+    }
+}
+
+void cover_worker::fetch(cover_request const & request, cover_collector & collector)
+{
+    // The disk cache adds the size to the file name itself.
+    auto const opt_key = cover_cache_key(request.get_song_path(), request.get_song_info());
+    auto const opt_sized_key = sized_cover_cache_key(request.get_song_path(), request.get_song_info(), request.get_size());
+
+    bool found = false;
+    if (opt_key.has_value() && _opt_cover_disk_cache.has_value())
+    {
+        collector.result().surface = _opt_cover_disk_cache->load(opt_key.value(), request.get_size());
+        found = static_cast<bool>(collector.result().surface);
+    }
+
+    bool const from_disk = found;
+    for (auto const & p : _cover_providers)
+    {
+        if (found || collector.is_cancelled())
+            break;
+
+        found = p.update_cover(collector, request);
+    }
+
+    // Even if it is outdated, the result is complete and worth caching. If
+    // only the text fallback succeeded, it is recorded that there is no
+    // cover, but only if no provider failed to tell.
+    auto const & surface = collector.result().surface;
+    if (found && opt_key.has_value() && (surface || !collector.has_failed()))
+    {
+        _cover_cache.insert(opt_sized_key.value(), surface);
+
+        if (surface && !from_disk && _opt_cover_disk_cache.has_value())
+        {
+            _opt_cover_disk_cache->store(opt_key.value(), request.get_size(), surface.get());
+        }
+    }
+}
+
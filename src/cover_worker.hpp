@@ -0,0 +1,115 @@
+// SPDX-FileCopyrightText: Moritz Bruder <muesli4 at gmail dot com>
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#ifndef COVER_WORKER_HPP
+#define COVER_WORKER_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/ptr_container/ptr_vector.hpp>
+
+#include "cover_cache.hpp"
+#include "cover_disk_cache.hpp"
+#include "cover_provider.hpp"
+#include "mpd_control.hpp"
+#include "program_config.hpp"
+#include "song_data_provider.hpp"
+#include "surface_util.hpp"
+
+struct cover_collector;
+
+// The song a cover is requested for and the size it will be displayed in.
+struct cover_request : song_data_provider
+{
+    cover_request(std::string path, song_info info, vec size);
+
+    song_info get_song_info() const override;
+    std::string get_song_path() const override;
+    vec get_size() const;
+
+    private:
+
+    std::string _path;
+    song_info _info;
+    vec _size;
+};
+
+// A decoded cover or, if there is none, the song information to display
+// instead.
+struct cover_result
+{
+    shared_surface_ptr surface;
+    song_info info;
+};
+
+// Fetches and decodes covers with the given providers on a separate thread.
+// Only the latest request is of interest: a new request cancels the one in
+// flight. Covers are scaled down to the display size and kept in a cache
+// shared by songs of the same album, separately for each size. Optionally, they are persisted on disk,
+// which is consulted before any provider.
+struct cover_worker
+{
+    // The queue song lookup is used for prefetching. The ready callback is
+    // called from the worker thread once a result can be taken.
+    cover_worker( boost::ptr_vector<cover_provider> const & cover_providers
+                , cover_config const & cfg
+                , std::function<std::optional<queue_song>(unsigned int)> queue_song_lookup
+                , std::function<void()> ready_callback
+                );
+    ~cover_worker();
+
+    // Returns the result right away if the cover is cached, otherwise it
+    // will be fetched in the background.
+    std::optional<cover_result> request(std::string path, song_info info, vec size);
+
+    // Fetch the covers of the songs at the given queue positions into the
+    // cache while there is no request. Replaces previous positions.
+    void prefetch(std::vector<unsigned int> const & positions);
+
+    // Returns the result of the latest request if it is available.
+    std::optional<cover_result> take_result();
+
+    // Cancel any request and wait for the thread to finish.
+    void stop();
+
+    private:
+
+    void run();
+
+    // Consult the caches and the providers, and cache the result.
+    void fetch(cover_request const & request, cover_collector & collector);
+
+    boost::ptr_vector<cover_provider> const & _cover_providers;
+    std::function<std::optional<queue_song>(unsigned int)> _queue_song_lookup;
+    std::function<void()> _ready_callback;
+
+    cover_cache _cover_cache;
+    std::optional<cover_disk_cache> _opt_cover_disk_cache;
+
+    // Identifies the latest request, anything else is outdated.
+    std::atomic<unsigned int> _generation;
+
+    std::mutex _mutex;
+    std::condition_variable _cv;
+    bool _run;
+    std::optional<cover_request> _opt_request;
+    std::optional<cover_result> _opt_result;
+
+    std::deque<unsigned int> _prefetch_positions;
+    // size of the latest request
+    vec _cover_size;
+
+    std::thread _thread;
+};
+
+#endif
+
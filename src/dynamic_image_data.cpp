@@ -14,3 +14,13 @@ dynamic_image_data::operator byte_array_slice()
 {
     return byte_array_slice(_buffer.data(), _size);
 }
+
+std::byte const * dynamic_image_data::data() const
+{
+    return _buffer.data();
+}
+
+size_t dynamic_image_data::size() const
+{
+    return _size;
+}
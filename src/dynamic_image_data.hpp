@@ -16,6 +16,9 @@ struct dynamic_image_data
 
     operator byte_array_slice();
 
+    std::byte const * data() const;
+    size_t size() const;
+
     private:
 
     byte_buffer _buffer;
@@ -5,6 +5,7 @@
 
 #include "event_loop.hpp"
 
+#include <algorithm>
 #include <array>
 #include <chrono>
 #include <cstdlib>
@@ -13,6 +14,7 @@
 #include <iostream>
 #include <iterator>
 #include <mutex>
+#include <numeric>
 #include <queue>
 #include <thread>
 
@@ -29,6 +31,7 @@
 #include <libwtk-sdl2/widget.hpp>
 #include <libwtk-sdl2/widget_context.hpp>
 
+#include "allocation_counter.hpp"
 #include "filesystem_cover_provider.hpp"
 #include "mpd_cover_provider.hpp"
 #include "text_cover_provider.hpp"
@@ -115,23 +118,56 @@ bool is_undim_event(SDL_Event & ev)
     }
 }
 
-/**
- * Refresh the current playlist by destructively updating the current state.
- *
- */
+// Songs fetched before the first frame.
+static unsigned int const PLAYLIST_WINDOW_SIZE = 200;
+
+// Songs fetched at once in the background. Covers share the connection, so it
+// is kept small.
+static unsigned int const PLAYLIST_RANGE_SIZE = 500;
+
+// Shown for songs that are not loaded yet.
+static char const * const PLAYLIST_PLACEHOLDER = "…";
+
+// A range or the changes of the queue that could not be fetched, e.g. because
+// there is no connection, are fetched again after this many milliseconds.
+static Uint32 const PLAYLIST_RETRY_DELAY = 2000;
+
+// Applies the changes since the last known version and stores the changed
+// positions in the given buffer, which keeps its capacity between updates.
 void refresh_current_playlist
     ( std::vector<std::string> & cpl
+    , search_index & si
     , unsigned int & cpv
-    , mpd_control & mpdc
+    , playlist_change_info & pci
+    , std::vector<std::size_t> & changed_positions
     )
 {
-    playlist_change_info pci = mpdc.get_current_playlist_changes(cpv);
+    changed_positions.clear();
+
+    // Nothing changed.
+    if (pci.new_version == cpv)
+        return;
+
+#ifdef COUNT_ALLOCATIONS
+    std::size_t const allocations_before = allocation_count();
+#endif
+
     cpl.resize(pci.new_length);
     cpv = pci.new_version;
+    // The index only uses the tags, the displayed text is moved.
     for (auto & p : pci.changed_positions)
     {
-        cpl[p.first] = p.second;
+        cpl[p.first] = std::move(p.second.display);
+        changed_positions.push_back(p.first);
     }
+    si.update(pci.new_length, pci.changed_positions, pci.tag_interner);
+
+#ifdef COUNT_ALLOCATIONS
+    // Allocations should grow with the number of changes, not with the length
+    // of the queue.
+    std::cerr << "Queue update: " << pci.changed_positions.size() << " of " << pci.new_length << " entries changed, "
+              << allocation_count() - allocations_before << " allocations" << std::endl;
+#endif
 }
 
 // TODO refactor
@@ -206,31 +242,37 @@ void event_loop::handle_other_event(SDL_Event const & e)
 void event_loop::add_user_event(std::function<void()> && f)
 {
     std::scoped_lock const lock(_user_event_queue_mutex);
-    _user_event_queue.emplace(f);
+    _user_event_queue.emplace(std::move(f));
     _change_event_sender.push();
 }
 
 event_loop::event_loop(SDL_Renderer * renderer, program_config const & cfg)
     : _playlist()
+    , _playlist_index(cfg.search.trigram_index)
+    , _playlist_window_start(0)
+    , _playlist_window_end(0)
+    , _playlist_retry_timer(0)
+    , _playlist_refresh_running(false)
+    , _playlist_window_loaded(false)
     , _current_song_pos(0)
     , _refresh_cover(true)
     , _dimmed(false)
 
     , _mpd_control(
-        [&](std::optional<song_location> opt_sl)
+        [&](std::optional<song_location> opt_sl, song_info info)
         {
-            // TODO probably move, as string copy might not be atomic
-            //      another idea is to completely move all song information
-            //      into the main thread
-            if (opt_sl.has_value())
+            // All song information is moved into the main thread, the cover
+            // providers do not have to ask for it.
+            add_user_event([&, opt_sl = std::move(opt_sl), info = std::move(info)]()
             {
-                auto const & sl = opt_sl.value();
-                _current_song_path = sl.path;
-                _current_song_pos = sl.pos;
-            }
+                if (opt_sl.has_value())
+                {
+                    auto const & sl = opt_sl.value();
+                    _current_song_path = sl.path;
+                    _current_song_pos = sl.pos;
+                }
+                _current_song_info = info;
 
-            add_user_event([&]()
-            {
                 _refresh_cover = true;
                 _player_view->on_song_changed(_current_song_pos);
             });
@@ -247,14 +289,9 @@ event_loop::event_loop(SDL_Renderer * renderer, program_config const & cfg)
             add_user_event([&]()
             {
                 if (_dimmed)
-                {
                     _current_playlist_needs_refresh = true;
-                }
                 else
-                {
-                    refresh_current_playlist(_playlist, _current_playlist_version, _mpd_control);
-                    _player_view->on_playlist_changed(_current_song_pos >= _playlist.size());
-                }
+                    refresh_playlist();
             });
         },
         [&](mpd_state state)
@@ -265,14 +302,199 @@ event_loop::event_loop(SDL_Renderer * renderer, program_config const & cfg)
             });
         })
     , _model(_mpd_control)
-    , _player_view(std::make_unique<player_gui>(renderer, _model, _playlist, _current_song_pos, cfg))
+    , _player_view(std::make_unique<player_gui>(renderer, _model, _playlist, _playlist_index, _current_song_pos, cfg, [this](std::function<void()> f){ add_user_event(std::move(f)); }))
+{
+}
+
+event_loop::~event_loop()
+{
+    if (_playlist_retry_timer != 0)
+        SDL_RemoveTimer(_playlist_retry_timer);
+}
+
+void event_loop::load_playlist_window()
+{
+    _mpd_control.fetch_current_queue_window(PLAYLIST_WINDOW_SIZE, [this](std::optional<queue_range> opt_window)
+    {
+        add_user_event([this, opt_window = std::move(opt_window)]() mutable
+        {
+            on_playlist_window_loaded(std::move(opt_window));
+        });
+    });
+}
+
+void event_loop::on_playlist_window_loaded(std::optional<queue_range> opt_window)
+{
+    if (!opt_window.has_value())
+    {
+        schedule_playlist_retry();
+        return;
+    }
+
+    queue_range & window = opt_window.value();
+    _current_playlist_version = window.version;
+    _playlist_window_start = window.start;
+    _playlist_window_end = window.start + window.entries.size();
+
+    std::vector<queue_entry> entries(window.length);
+    _playlist.assign(window.length, PLAYLIST_PLACEHOLDER);
+    for (std::size_t i = 0; i < window.entries.size() && window.start + i < window.length; ++i)
+    {
+        _playlist[window.start + i] = std::move(window.entries[i].display);
+        entries[window.start + i] = std::move(window.entries[i]);
+    }
+    _playlist_index.assign(entries, window.tag_interner);
+    _playlist_window_loaded = true;
+
+    _changed_playlist_positions.resize(_playlist.size());
+    std::iota(_changed_playlist_positions.begin(), _changed_playlist_positions.end(), 0);
+    _player_view->on_playlist_changed(_current_song_pos >= _playlist.size(), _changed_playlist_positions);
+
+    load_playlist_range(0);
+
+    // Changes that arrived while the window was missing are relative to it.
+    if (_current_playlist_needs_refresh && !_dimmed)
+        refresh_playlist();
+}
+
+void event_loop::load_playlist_range(unsigned int start)
+{
+    // The window is loaded already.
+    if (start >= _playlist_window_start && start < _playlist_window_end)
+        start = _playlist_window_end;
+
+    if (start >= _playlist.size())
+        return;
+
+    unsigned int end = start + PLAYLIST_RANGE_SIZE;
+    if (start < _playlist_window_start)
+        end = std::min(end, _playlist_window_start);
+
+    _mpd_control.fetch_queue_range(start, end, [this, start](std::optional<queue_range> opt_range)
+    {
+        add_user_event([this, start, opt_range = std::move(opt_range)]() mutable
+        {
+            on_playlist_range_loaded(start, std::move(opt_range));
+        });
+    });
+}
+
+void event_loop::on_playlist_range_loaded(unsigned int start, std::optional<queue_range> opt_range)
+{
+    // A range of an older queue is fetched again right away. A range of a
+    // newer queue has to wait for the changes to be applied first. A failed
+    // range is fetched again later or with the next change, whatever comes
+    // first.
+    if (!opt_range.has_value())
+    {
+        _opt_stalled_playlist_range = start;
+        schedule_playlist_retry();
+        return;
+    }
+    if (opt_range->version > _current_playlist_version)
+    {
+        _opt_stalled_playlist_range = start;
+        return;
+    }
+    if (opt_range->version < _current_playlist_version)
+    {
+        load_playlist_range(start);
+        return;
+    }
+
+    _changed_playlist_positions.clear();
+    // Emptied after use, only its capacity is kept.
+    auto & changed_positions = _playlist_range_changes;
+    for (std::size_t i = 0; i < opt_range->entries.size() && start + i < _playlist.size(); ++i)
+    {
+        queue_entry & e = opt_range->entries[i];
+        _playlist[start + i] = std::move(e.display);
+        _changed_playlist_positions.push_back(start + i);
+        changed_positions.emplace_back(start + i, std::move(e));
+    }
+
+    if (!_changed_playlist_positions.empty())
+    {
+        _playlist_index.update(_playlist.size(), changed_positions, opt_range->tag_interner);
+        _player_view->on_playlist_changed(false, _changed_playlist_positions);
+        load_playlist_range(start + _changed_playlist_positions.size());
+    }
+    changed_positions.clear();
+}
+
+Uint32 event_loop::playlist_retry_cb(Uint32 interval, void * event_loop_ptr)
 {
-    // TODO not clear why this is needed, something is locking up here otherwise
-    add_user_event([&]()
+    event_loop * const el = static_cast<event_loop *>(event_loop_ptr);
+    el->add_user_event([el]()
     {
-        _player_view->on_random_changed(_mpd_control.get_random());
-        _player_view->on_playback_state_changed(_mpd_control.get_state());
+        el->_playlist_retry_timer = 0;
+        if (!el->_playlist_window_loaded)
+        {
+            el->load_playlist_window();
+            return;
+        }
+        if (el->_current_playlist_needs_refresh && !el->_dimmed)
+            el->refresh_playlist();
+        el->resume_playlist_loading();
     });
+    return 0;
+}
+
+void event_loop::schedule_playlist_retry()
+{
+    if (_playlist_retry_timer == 0)
+        _playlist_retry_timer = SDL_AddTimer(PLAYLIST_RETRY_DELAY, playlist_retry_cb, this);
+}
+
+void event_loop::refresh_playlist()
+{
+    // Changes are fetched one after another, each relative to the version of
+    // the previous one. Without a window there is nothing to change yet.
+    if (_playlist_refresh_running || !_playlist_window_loaded)
+    {
+        _current_playlist_needs_refresh = true;
+        return;
+    }
+
+    _current_playlist_needs_refresh = false;
+    _playlist_refresh_running = true;
+    _mpd_control.fetch_playlist_changes(_current_playlist_version, [this](std::optional<playlist_change_info> opt_pci)
+    {
+        add_user_event([this, opt_pci = std::move(opt_pci)]() mutable
+        {
+            on_playlist_changes_loaded(std::move(opt_pci));
+        });
+    });
+}
+
+void event_loop::on_playlist_changes_loaded(std::optional<playlist_change_info> opt_pci)
+{
+    _playlist_refresh_running = false;
+
+    if (!opt_pci.has_value())
+    {
+        _current_playlist_needs_refresh = true;
+        schedule_playlist_retry();
+        return;
+    }
+
+    refresh_current_playlist(_playlist, _playlist_index, _current_playlist_version, opt_pci.value(), _changed_playlist_positions);
+    _player_view->on_playlist_changed(_current_song_pos >= _playlist.size(), _changed_playlist_positions);
+    resume_playlist_loading();
+
+    // Changes that arrived in between.
+    if (_current_playlist_needs_refresh && !_dimmed)
+        refresh_playlist();
+}
+
+void event_loop::resume_playlist_loading()
+{
+    if (_opt_stalled_playlist_range.has_value())
+    {
+        unsigned int const start = _opt_stalled_playlist_range.value();
+        _opt_stalled_playlist_range.reset();
+        load_playlist_range(start);
+    }
 }
 
 void event_loop::fill_cover_providers_from_config(cover_config const & cfg, boost::ptr_vector<cover_provider> & cover_providers)
@@ -316,6 +538,24 @@ quit_action event_loop::run(program_config const & cfg)
     boost::ptr_vector<cover_provider> cover_providers;
     fill_cover_providers_from_config(cfg.cover, cover_providers);
 
+    // Covers are fetched and decoded in the background, only the texture is
+    // created in this thread.
+    cover_worker cw(cover_providers, cfg.cover, [&](unsigned int pos)
+    {
+        return _mpd_control.get_queue_song(pos);
+    },
+    [&]()
+    {
+        add_user_event([&]()
+        {
+            auto opt_result = cw.take_result();
+            if (opt_result.has_value())
+            {
+                update_cover(opt_result.value());
+            }
+        });
+    });
+
     idle_timer_info iti(tes);
 
     // timer is enabled
@@ -337,8 +577,10 @@ quit_action event_loop::run(program_config const & cfg)
 
     try
     {
-        // get initial state from mpd
-        std::tie(_playlist, _current_playlist_version) = _mpd_control.get_current_playlist();
+        // get initial state from mpd, only the songs around the current one
+        // are fetched before the first frame
+        _current_playlist_version = 0;
+        on_playlist_window_loaded(_mpd_control.get_current_queue_window(PLAYLIST_WINDOW_SIZE));
 
         // TODO ask mpd state!
 
@@ -389,11 +631,7 @@ quit_action event_loop::run(program_config const & cfg)
                             if (is_undim_event(ev))
                             {
                                 if (_current_playlist_needs_refresh)
-                                {
-                                    refresh_current_playlist(_playlist, _current_playlist_version, _mpd_control);
-                                    _current_playlist_needs_refresh = false;
-                                    _player_view->on_playlist_changed(_current_song_pos >= _playlist.size());
-                                }
+                                    refresh_playlist();
                                 // ignore one event, turn on lights
                                 _dimmed = false;
                                 // TODO run after drawing
@@ -418,13 +656,21 @@ quit_action event_loop::run(program_config const & cfg)
                 // Avoid unnecessary I/O on slower devices.
                 if (_refresh_cover)
                 {
-                    for (auto const & p : cover_providers)
+                    auto opt_result = cw.request(_current_song_path, _current_song_info, _player_view->get_cover_size());
+                    if (opt_result.has_value())
                     {
-                        if (p.update_cover(*_player_view, *this))
-                        {
-                            break;
-                        }
+                        update_cover(opt_result.value());
                     }
+
+                    // Have the neighbors ready when skipping.
+                    std::vector<unsigned int> positions;
+                    int const next_song_pos = _mpd_control.get_status().next_song_pos;
+                    if (next_song_pos >= 0)
+                        positions.push_back(next_song_pos);
+                    if (_current_song_pos > 0)
+                        positions.push_back(_current_song_pos - 1);
+                    cw.prefetch(positions);
+
                     _refresh_cover = false;
                 }
 
@@ -437,6 +683,9 @@ quit_action event_loop::run(program_config const & cfg)
         std::cerr << e.what() << std::endl;
     }
 
+    // The worker may wait for MPD.
+    cw.stop();
+
     _mpd_control.stop();
     mpdc_thread.join();
 
@@ -449,17 +698,15 @@ quit_action event_loop::run(program_config const & cfg)
     return _model.get_quit_action();
 }
 
-song_info event_loop::get_song_info() const
-{
-    song_info result;
-    result.title = _mpd_control.get_current_title();
-    result.artist = _mpd_control.get_current_artist();
-    result.album = _mpd_control.get_current_album();
-    return result;
-}
-
-std::string event_loop::get_song_path() const
+void event_loop::update_cover(cover_result const & result)
 {
-    return _current_song_path;
+    if (result.surface)
+    {
+        _player_view->update_cover_from_surface(result.surface.get());
+    }
+    else
+    {
+        _player_view->update_cover_from_song_info(result.info);
+    }
 }
 
@@ -11,7 +11,7 @@
 #include <SDL2/SDL.h>
 
 #include "cover_provider.hpp"
-#include "song_data_provider.hpp"
+#include "cover_worker.hpp"
 #include "program_config.hpp"
 #include "navigation_event.hpp"
 #include "player_view.hpp"
@@ -19,22 +19,20 @@
 #include "mpd_control.hpp"
 #include "player_mpd_model.hpp"
 #include "quit_action.hpp"
+#include "search_index.hpp"
 
 
 bool idle_timer_enabled(program_config const & cfg);
 
-struct event_loop : private song_data_provider
+struct event_loop
 {
     event_loop(SDL_Renderer * renderer, program_config const & cfg);
+    ~event_loop();
 
     quit_action run(program_config const & cfg);
 
     private:
 
-    // get information about the current song
-    song_info get_song_info() const;
-    std::string get_song_path() const;
-
     void fill_cover_providers_from_config(cover_config const & cfg, boost::ptr_vector<cover_provider> & cover_providers);
 
     void handle_other_event(SDL_Event const & e);
@@ -47,10 +45,46 @@ struct event_loop : private song_data_provider
 
     void add_user_event(std::function<void()> && f);
 
+    void update_cover(cover_result const & result);
+
+    // The songs around the current one are loaded first. If that fails, it is
+    // retried with the timer until it succeeds.
+    void load_playlist_window();
+    void on_playlist_window_loaded(std::optional<queue_range> opt_window);
+
+    // The queue is loaded in ranges in the background. Loading stalls if the
+    // queue changed in between and resumes once the changes are applied. It
+    // also stalls if a range fails and resumes with a timer.
+    void load_playlist_range(unsigned int start);
+    void on_playlist_range_loaded(unsigned int start, std::optional<queue_range> opt_range);
+    static Uint32 playlist_retry_cb(Uint32 interval, void * event_loop_ptr);
+    void schedule_playlist_retry();
+    void resume_playlist_loading();
+
+    // Changes of the queue are fetched in the background as well. Only one
+    // fetch runs at a time, changes in between are fetched afterwards. A
+    // failed fetch is retried with the timer.
+    void refresh_playlist();
+    void on_playlist_changes_loaded(std::optional<playlist_change_info> opt_pci);
+
     // loop state
+    // The displayed queue and its search index. Positions match.
     std::vector<std::string> _playlist;
+    search_index _playlist_index;
+    // Positions of the last applied changes and the entries of the last
+    // loaded range, reused between updates.
+    std::vector<std::size_t> _changed_playlist_positions;
+    search_index::diff_type _playlist_range_changes;
+    // loaded at startup
+    unsigned int _playlist_window_start;
+    unsigned int _playlist_window_end;
+    std::optional<unsigned int> _opt_stalled_playlist_range;
+    SDL_TimerID _playlist_retry_timer;
+    bool _playlist_refresh_running;
+    bool _playlist_window_loaded;
     unsigned int _current_song_pos;
     std::string _current_song_path;
+    song_info _current_song_info;
     unsigned int _current_playlist_version;
     bool _refresh_cover;
     bool _dimmed;
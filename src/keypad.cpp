@@ -6,9 +6,10 @@
 #include "util.hpp"
 #include "keypad.hpp"
 
-keypad::keypad(vec size, std::string keys, std::function<void(std::string)> submit_callback)
+keypad::keypad(vec size, std::string keys, std::function<void(std::string)> submit_callback, std::function<void(std::string)> change_callback)
     : keypad(size, construct(size, keys, submit_callback))
 {
+    _change_callback = change_callback;
 }
 
 keypad::keypad(vec size, std::tuple<std::shared_ptr<text_button>, std::vector<grid::entry>> tmp)
@@ -33,7 +34,17 @@ void keypad::remove_last()
 
 void keypad::update()
 {
-    _submit_button->set_label('\'' + _search_term + '\'');
+    if (_change_callback)
+        _change_callback(_search_term);
+    update_label();
+}
+
+void keypad::update_label()
+{
+    std::string label = '\'' + _search_term + '\'';
+    if (_opt_match_count.has_value())
+        label += " (" + std::to_string(_opt_match_count.value()) + ')';
+    _submit_button->set_label(label);
 }
 
 void keypad::append(std::string c)
@@ -48,6 +59,12 @@ void keypad::clear()
     update();
 }
 
+void keypad::set_match_count(std::optional<std::size_t> opt_count)
+{
+    _opt_match_count = opt_count;
+    update_label();
+}
+
 std::string_view const keypad::get_input() const
 {
     return _search_term;
@@ -4,33 +4,41 @@
 
 #pragma once
 
+#include <optional>
 #include <string>
 #include <string_view>
 #include <libwtk-sdl2/grid.hpp>
 #include <libwtk-sdl2/text_button.hpp>
 #include <libwtk-sdl2/embedded_widget.hpp>
 
-// Provides a widget with a keypad that can be submitted.
+// Provides a widget with a keypad that can be submitted. The change callback
+// is called whenever the input changes.
 struct keypad : embedded_widget<grid>
 {
 
-    keypad(vec size, std::string keys, std::function<void(std::string)> submit_callback);
+    keypad(vec size, std::string keys, std::function<void(std::string)> submit_callback, std::function<void(std::string)> change_callback = {});
     ~keypad() override;
 
     void clear();
     std::string_view const get_input() const;
 
+    // Shown next to the input on the submit button.
+    void set_match_count(std::optional<std::size_t> opt_count);
+
     private:
 
     keypad(vec size, std::tuple<std::shared_ptr<text_button>, std::vector<grid::entry>> tmp);
 
     void remove_last();
     void update();
+    void update_label();
     void append(std::string c);
     
     std::tuple<std::shared_ptr<text_button>, std::vector<grid::entry>> construct(vec size, std::string keys, std::function<void(std::string)> submit_callback);
 
     std::shared_ptr<text_button> _submit_button;
+    std::function<void(std::string)> _change_callback;
     std::string _search_term;
+    std::optional<std::size_t> _opt_match_count;
 };
 
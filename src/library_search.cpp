@@ -0,0 +1,108 @@
+// SPDX-FileCopyrightText: Moritz Bruder <muesli4 at gmail dot com>
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include <algorithm>
+#include <iterator>
+
+#include "library_search.hpp"
+
+// The first page is shown quickly, later ones are larger to save round-trips.
+static unsigned int const FIRST_PAGE_SIZE = 50;
+static unsigned int const MAX_PAGE_SIZE = 400;
+
+library_search::library_search(fetch_function fetch, unsigned int limit, std::function<void()> ready_callback)
+    : _fetch(fetch)
+    , _limit(limit)
+    , _ready_callback(ready_callback)
+    , _generation(0)
+    , _run(true)
+{
+    _thread = std::thread(&library_search::run, this);
+}
+
+library_search::~library_search()
+{
+    stop();
+}
+
+void library_search::request(unsigned int id, search_query query)
+{
+    {
+        std::scoped_lock lock(_mutex);
+        _generation++;
+        _opt_result.reset();
+        _opt_request.emplace(id, std::move(query));
+    }
+    _cv.notify_one();
+}
+
+std::optional<library_result> library_search::take_result()
+{
+    std::scoped_lock lock(_mutex);
+    std::optional<library_result> result;
+    result.swap(_opt_result);
+    return result;
+}
+
+void library_search::stop()
+{
+    {
+        std::scoped_lock lock(_mutex);
+        _run = false;
+        _generation++;
+    }
+    _cv.notify_one();
+
+    if (_thread.joinable())
+        _thread.join();
+}
+
+void library_search::run()
+{
+    std::unique_lock lock(_mutex);
+    while (true)
+    {
+        _cv.wait(lock, [this](){ return !_run || _opt_request.has_value(); });
+        if (!_run)
+            break;
+
+        auto [id, query] = std::move(_opt_request.value());
+        _opt_request.reset();
+        unsigned int const generation = _generation;
+
+        unsigned int start = 0;
+        unsigned int page_size = FIRST_PAGE_SIZE;
+        bool complete = false;
+        while (!complete && _generation == generation)
+        {
+            lock.unlock();
+            unsigned int const end = std::min(start + page_size, _limit);
+            auto songs = _fetch(query, start, end);
+            complete = songs.size() < end - start || end == _limit;
+            lock.lock();
+
+            if (_generation != generation)
+                break;
+
+            // Append if the previous page was not taken yet.
+            if (_opt_result.has_value())
+            {
+                auto & result_songs = _opt_result->songs;
+                result_songs.insert(result_songs.end(), std::make_move_iterator(songs.begin()), std::make_move_iterator(songs.end()));
+                _opt_result->complete = complete;
+            }
+            else
+            {
+                _opt_result = library_result{ id, std::move(songs), complete };
+            }
+
+            lock.unlock();
+            _ready_callback();
+            lock.lock();
+
+            start = end;
+            page_size = std::min(page_size * 2, MAX_PAGE_SIZE);
+        }
+    }
+}
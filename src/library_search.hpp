@@ -0,0 +1,65 @@
+// SPDX-FileCopyrightText: Moritz Bruder <muesli4 at gmail dot com>
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+#include "queue_entry.hpp"
+#include "search_query.hpp"
+
+struct library_result
+{
+    unsigned int id;
+    // the songs that arrived since the last result was taken
+    std::vector<library_song> songs;
+    // no more songs will follow
+    bool complete;
+};
+
+// Searches the database page by page in the background, so the first songs
+// can be shown while later ones are still being transferred. Only the latest
+// request is of interest: a new request cancels the one in flight.
+struct library_search
+{
+    typedef std::function<std::vector<library_song>(search_query const &, unsigned int, unsigned int)> fetch_function;
+
+    // Fetch returns the songs in a window and is called from the worker
+    // thread, at most limit songs are fetched per request. The ready callback
+    // is called from the worker thread once a result can be taken.
+    library_search(fetch_function fetch, unsigned int limit, std::function<void()> ready_callback);
+    ~library_search();
+
+    void request(unsigned int id, search_query query);
+
+    // Returns the songs of the latest request that are available.
+    std::optional<library_result> take_result();
+
+    void stop();
+
+    private:
+
+    void run();
+
+    fetch_function _fetch;
+    unsigned int _limit;
+    std::function<void()> _ready_callback;
+
+    // Increased with every request, a search is cancelled if it changes.
+    std::atomic<unsigned int> _generation;
+
+    std::mutex _mutex;
+    std::condition_variable _cv;
+    bool _run;
+    std::optional<std::pair<unsigned int, search_query>> _opt_request;
+    std::optional<library_result> _opt_result;
+
+    std::thread _thread;
+};
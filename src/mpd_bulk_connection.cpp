@@ -0,0 +1,109 @@
+// SPDX-FileCopyrightText: Moritz Bruder <muesli4 at gmail dot com>
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include "mpd_bulk_connection.hpp"
+
+// MPD closes connections that are idle for a while (60 seconds by default).
+static std::chrono::seconds const IDLE_CHECK_INTERVAL(10);
+
+mpd_bulk_connection::mpd_bulk_connection()
+    : _c(nullptr)
+    , _run(true)
+{
+    _thread = std::thread(&mpd_bulk_connection::run, this);
+}
+
+mpd_bulk_connection::~mpd_bulk_connection()
+{
+    stop();
+    disconnect();
+}
+
+void mpd_bulk_connection::add_task(std::function<void(mpd_connection *)> && t)
+{
+    {
+        std::scoped_lock lock(_mutex);
+        if (_run)
+        {
+            _tasks.push_back(std::move(t));
+            _cv.notify_one();
+            return;
+        }
+    }
+    t(nullptr);
+}
+
+void mpd_bulk_connection::stop()
+{
+    {
+        std::scoped_lock lock(_mutex);
+        _run = false;
+    }
+    _cv.notify_one();
+
+    if (_thread.joinable())
+        _thread.join();
+}
+
+void mpd_bulk_connection::run()
+{
+    std::unique_lock lock(_mutex);
+    while (true)
+    {
+        _cv.wait(lock, [this](){ return !_run || !_tasks.empty(); });
+
+        if (_tasks.empty())
+            break;
+
+        auto task = std::move(_tasks.front());
+        _tasks.pop_front();
+        bool const connect = _run;
+        lock.unlock();
+
+        mpd_connection * c = connect ? ensure_connection() : nullptr;
+        task(c);
+
+        if (c != nullptr)
+        {
+            // Errors reported by MPD leave the connection usable, everything
+            // else requires a new one.
+            if (mpd_connection_get_error(c) != MPD_ERROR_SUCCESS && !mpd_connection_clear_error(c))
+                disconnect();
+            else
+                _last_used = std::chrono::steady_clock::now();
+        }
+
+        lock.lock();
+    }
+}
+
+mpd_connection * mpd_bulk_connection::ensure_connection()
+{
+    if (_c != nullptr && std::chrono::steady_clock::now() - _last_used > IDLE_CHECK_INTERVAL)
+    {
+        if (!mpd_run_ping(_c))
+            disconnect();
+    }
+
+    if (_c == nullptr)
+    {
+        _c = mpd_connection_new(nullptr, 0, 0);
+        if (_c == nullptr || mpd_connection_get_error(_c) != MPD_ERROR_SUCCESS)
+        {
+            disconnect();
+            return nullptr;
+        }
+    }
+
+    return _c;
+}
+
+void mpd_bulk_connection::disconnect()
+{
+    if (_c != nullptr)
+    {
+        mpd_connection_free(_c);
+        _c = nullptr;
+    }
+}
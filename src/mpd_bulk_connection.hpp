@@ -0,0 +1,64 @@
+// SPDX-FileCopyrightText: Moritz Bruder <muesli4 at gmail dot com>
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+
+#include <mpd/client.h>
+
+// A second connection to MPD for transfers that take long, like covers or the
+// whole queue. Its tasks run in order on a separate thread, so they never
+// delay control commands and idle events on the main connection.
+//
+// The connection is established on demand and reestablished after it has been
+// lost (e.g., if MPD closed it due to inactivity).
+struct mpd_bulk_connection
+{
+    mpd_bulk_connection();
+    ~mpd_bulk_connection();
+
+    // The task is given nullptr if there is no connection, either because
+    // connecting failed or because the connection has been stopped.
+    void add_task(std::function<void(mpd_connection *)> && t);
+
+    template <typename R>
+    R add_task_with_return(std::function<R(mpd_connection *)> && f)
+    {
+        std::promise<R> promise;
+        add_task([&promise, f](mpd_connection * c)
+        {
+            promise.set_value(f(c));
+        });
+        return promise.get_future().get();
+    }
+
+    // Remaining tasks are run without a connection.
+    void stop();
+
+    private:
+
+    void run();
+
+    // Returns nullptr on failure.
+    mpd_connection * ensure_connection();
+
+    void disconnect();
+
+    mpd_connection * _c;
+    std::chrono::steady_clock::time_point _last_used;
+
+    std::mutex _mutex;
+    std::condition_variable _cv;
+    bool _run;
+    std::deque<std::function<void(mpd_connection *)>> _tasks;
+
+    std::thread _thread;
+};
@@ -2,7 +2,9 @@
 //
 // SPDX-License-Identifier: LGPL-3.0-or-later
 
+#include <algorithm>
 #include <chrono>
+#include <functional>
 #include <thread>
 #include <cstring>
 #include <cinttypes>
@@ -18,16 +20,24 @@
 #include <poll.h>
 #endif
 
-playlist_change_info::playlist_change_info(int nv, playlist_change_info::diff_type && cp, unsigned int l)
+playlist_change_info::playlist_change_info(int nv, playlist_change_info::diff_type && cp, unsigned int l, std::shared_ptr<string_interner> ti)
     : new_version(nv)
-    , changed_positions(cp)
+    , changed_positions(std::move(cp))
     , new_length(l)
+    , tag_interner(std::move(ti))
 {
 }
 
-mpd_control::mpd_control(std::function<void(std::optional<song_location>)> new_song_cb, std::function<void(bool)> random_cb, std::function<void()> playlist_changed_cb, std::function<void(mpd_state)> playback_state_changed_cb)
+bool external_task::is_pipelined() const
+{
+    return static_cast<bool>(receive);
+}
+
+mpd_control::mpd_control(std::function<void(std::optional<song_location>, song_info)> new_song_cb, std::function<void(bool)> random_cb, std::function<void()> playlist_changed_cb, std::function<void(mpd_state)> playback_state_changed_cb)
     : _c(mpd_connection_new(nullptr, 0, 0))
+    , _tag_interner(std::make_shared<string_interner>())
     , _run(true)
+    , _pending_volume_delta(0)
     , _new_song_cb(new_song_cb)
     , _random_cb(random_cb)
     , _playlist_changed_cb(playlist_changed_cb)
@@ -83,166 +93,287 @@ void mpd_control::notify()
 #endif
 }
 
+static status_info status_info_from_mpd_status(mpd_status * s)
+{
+    status_info result;
+    result.volume = mpd_status_get_volume(s);
+    result.state = mpd_status_get_state(s);
+    result.random = mpd_status_get_random(s);
+    result.next_song_pos = mpd_status_get_next_song_pos(s);
+    return result;
+}
+
+void mpd_control::handle_idle_event(int idle_event, bool initial, mpd_song * & last_song)
+{
+    bool const song_changed = initial || (idle_event & MPD_IDLE_PLAYER);
+
+    mpd_command_list_begin(_c, true);
+    mpd_send_status(_c);
+    if (song_changed)
+        mpd_send_current_song(_c);
+    mpd_command_list_end(_c);
+
+    mpd_status * s = mpd_recv_status(_c);
+    bool ok = s != nullptr && mpd_response_next(_c);
+
+    mpd_song * song = nullptr;
+    if (ok && song_changed)
+    {
+        song = mpd_recv_song(_c);
+        ok = mpd_response_next(_c);
+    }
+
+    if (!ok || !mpd_response_finish(_c))
+    {
+        mpd_connection_clear_error(_c);
+        if (s != nullptr)
+            mpd_status_free(s);
+        if (song != nullptr)
+            mpd_song_free(song);
+        return;
+    }
+
+    status_info const status = status_info_from_mpd_status(s);
+    mpd_status_free(s);
+    _status.store(status);
+
+    if (song_changed)
+    {
+        if (last_song != nullptr)
+        {
+            if (song == nullptr || (song != nullptr && mpd_song_get_id(last_song) != mpd_song_get_id(song)))
+                new_song_cb(song);
+            mpd_song_free(last_song);
+        }
+        else
+        {
+            if (song != nullptr || initial)
+                new_song_cb(song);
+        }
+        last_song = song;
+
+        _playback_state_changed_cb(status.state);
+    }
+    if (initial || (idle_event & MPD_IDLE_OPTIONS))
+    {
+        _random_cb(status.random);
+    }
+}
+
 void mpd_control::run()
 {
-    mpd_song * last_song = mpd_run_current_song(_c);
+    mpd_song * last_song = nullptr;
 
-    new_song_cb(last_song);
+    handle_idle_event(0, true, last_song);
 
     while (_run)
     {
-        mpd_send_idle_mask(_c, static_cast<mpd_idle>(MPD_IDLE_PLAYER | MPD_IDLE_OPTIONS | MPD_IDLE_PLAYLIST));
+        mpd_send_idle_mask(_c, static_cast<mpd_idle>(MPD_IDLE_PLAYER | MPD_IDLE_OPTIONS | MPD_IDLE_MIXER | MPD_IDLE_PLAYLIST));
 
         wait();
 
         enum mpd_idle idle_event = mpd_run_noidle(_c);
-        if (idle_event & MPD_IDLE_PLAYER)
-        {
-            mpd_song * song = mpd_run_current_song(_c);
-
-            if (last_song != nullptr)
-            {
-                if (song == nullptr || (song != nullptr && mpd_song_get_id(last_song) != mpd_song_get_id(song)))
-                    new_song_cb(song);
-                mpd_song_free(last_song);
-            }
-            else
-            {
-                if (song != nullptr)
-                    new_song_cb(song);
-            }
-            last_song = song;
-            {
-                mpd_status * s = mpd_run_status(_c);
-                _playback_state_changed_cb(mpd_status_get_state(s));
-                mpd_status_free(s);
-            }
-        }
-        if (idle_event & MPD_IDLE_OPTIONS)
+        // The queue version and length are part of the status as well.
+        if (idle_event & (MPD_IDLE_PLAYER | MPD_IDLE_OPTIONS | MPD_IDLE_MIXER | MPD_IDLE_PLAYLIST))
         {
-            mpd_status * s = mpd_run_status(_c);
-            _random_cb(mpd_status_get_random(s));
-            mpd_status_free(s);
+            handle_idle_event(idle_event, false, last_song);
         }
-        _external_tasks.run(_c);
+        run_external_tasks();
         if (idle_event & MPD_IDLE_PLAYLIST)
         {
             _playlist_changed_cb();
         }
-        _external_song_queries.run(_c, last_song);
     }
     if (last_song != nullptr)
         mpd_song_free(last_song);
 }
 
+void mpd_control::run_external_tasks()
+{
+    _external_tasks.take_all(_current_tasks);
+
+    // All volume changes since the last iteration result in a single absolute
+    // one, it is sent with the other pipelined tasks.
+    int const volume_delta = _pending_volume_delta.exchange(0);
+    if (volume_delta != 0)
+    {
+        _current_tasks.push_front(external_task
+            { [this, volume_delta](mpd_connection * c){ change_volume(c, volume_delta); }
+            , [](mpd_connection *, bool){}
+            });
+    }
+
+    if (_current_tasks.empty())
+        return;
+
+    auto it = _current_tasks.begin();
+    while (it != _current_tasks.end())
+    {
+        if (it->is_pipelined())
+        {
+            // Batch all consecutive pipelined tasks into one round-trip.
+            auto end = std::find_if_not(it, _current_tasks.end(), std::mem_fn(&external_task::is_pipelined));
+            run_command_list(it, end);
+            it = end;
+        }
+        else
+        {
+            it->send(_c);
+            ++it;
+        }
+    }
+    _current_tasks.clear();
+}
+
+void mpd_control::run_command_list(std::deque<external_task>::iterator begin, std::deque<external_task>::iterator end)
+{
+    mpd_command_list_begin(_c, true);
+    for (auto it = begin; it != end; ++it)
+    {
+        it->send(_c);
+    }
+    bool ok = mpd_command_list_end(_c);
+
+    auto it = begin;
+    while (ok && it != end)
+    {
+        it->receive(_c, true);
+        ++it;
+        ok = mpd_response_next(_c);
+    }
+
+    // MPD aborts the command list on the first failing command. The task that
+    // failed has seen the error, the tasks after it are unrelated and run
+    // again in a new command list.
+    if (it != begin && mpd_connection_get_error(_c) == MPD_ERROR_SERVER && mpd_connection_clear_error(_c))
+    {
+        if (it != end)
+            run_command_list(it, end);
+        return;
+    }
+
+    // Without a usable connection the remaining tasks are notified without a
+    // reply.
+    for (; it != end; ++it)
+    {
+        it->receive(_c, false);
+    }
+
+    if (!mpd_response_finish(_c))
+    {
+        mpd_connection_clear_error(_c);
+    }
+}
+
 void mpd_control::stop()
 {
+    _bulk.stop();
     _run = false;
     notify();
 }
 
 void mpd_control::toggle_pause()
 {
-    add_external_task([](mpd_connection * c)
+    add_pipelined_task([this](mpd_connection * c)
     {
-        mpd_status * s = mpd_run_status(c);
-        mpd_state state = mpd_status_get_state(s);
+        mpd_state state = _status.load().state;
         if (state == MPD_STATE_UNKNOWN || state == MPD_STATE_STOP)
         {
-            mpd_run_play(c);
+            mpd_send_play(c);
         }
         else
         {
-            mpd_run_toggle_pause(c);
+            mpd_send_toggle_pause(c);
         }
-    });
+    }, [](mpd_connection *, bool){});
 }
 
 void mpd_control::inc_volume(unsigned int amount)
 {
-    add_external_task([amount](mpd_connection * c)
-    {
-        mpd_status * s = mpd_run_status(c);
-        int new_volume = std::min(100, mpd_status_get_volume(s) + static_cast<int>(amount));
-        mpd_run_set_volume(c, new_volume);
-    });
+    _pending_volume_delta += static_cast<int>(amount);
+    notify();
 }
 
 void mpd_control::dec_volume(unsigned int amount)
 {
-    add_external_task([amount](mpd_connection * c)
-    {
-        mpd_status * s = mpd_run_status(c);
-        int new_volume = std::max(0, mpd_status_get_volume(s) - static_cast<int>(amount));
-        mpd_run_set_volume(c, new_volume);
-    });
+    _pending_volume_delta -= static_cast<int>(amount);
+    notify();
+}
+
+void mpd_control::change_volume(mpd_connection * c, int delta)
+{
+    status_info status = _status.load();
+    if (status.volume < 0)
+        return;
+
+    // Update the snapshot right away, so changes queued before the mixer idle
+    // event arrives are based on it.
+    status.volume = std::clamp(status.volume + delta, 0, 100);
+    _status.store(status);
+    mpd_send_set_volume(c, status.volume);
 }
 
 void mpd_control::next_song()
 {
-    add_external_task([](mpd_connection * c){ mpd_run_next(c); });
+    add_pipelined_task([](mpd_connection * c){ mpd_send_next(c); }, [](mpd_connection *, bool){});
 }
 
 void mpd_control::prev_song()
 {
-    add_external_task([](mpd_connection * c){ mpd_run_previous(c); });
+    add_pipelined_task([](mpd_connection * c){ mpd_send_previous(c); }, [](mpd_connection *, bool){});
 }
 
 void mpd_control::play_position(int pos)
 {
-    add_external_task([pos](mpd_connection * c)
+    add_pipelined_task([pos](mpd_connection * c){ mpd_send_play_pos(c, pos); }, [](mpd_connection *, bool){});
+}
+
+void mpd_control::add_and_play(std::string path)
+{
+    add_external_task([path](mpd_connection * c)
     {
-        if (!mpd_run_play_pos(c, pos))
-        {
+        int const id = mpd_run_add_id(c, path.c_str());
+        if (id < 0 || !mpd_run_play_id(c, id))
             mpd_connection_clear_error(c);
-        }
     });
 }
 
 void mpd_control::set_random(bool value)
 {
-    add_external_task([value](mpd_connection * c) { mpd_run_random(c, value); });
-}
-
-bool mpd_control::get_random()
-{
-    return add_external_task_with_return<bool>([](mpd_connection * c){
-        mpd_status * s = mpd_run_status(c);
-        bool v = mpd_status_get_random(s);
-        mpd_status_free(s);
-        return v;
-    });
+    add_pipelined_task([value](mpd_connection * c) { mpd_send_random(c, value); }, [](mpd_connection *, bool){});
 }
 
-mpd_state mpd_control::get_state()
+bool mpd_control::get_random() const
 {
-    return add_external_task_with_return<mpd_state>([](mpd_connection * c){
-        mpd_status * s = mpd_run_status(c);
-        mpd_state v = mpd_status_get_state(s);
-        mpd_status_free(s);
-        return v;
-    });
+    return _status.load().random;
 }
 
-void mpd_control::toggle_random()
+mpd_state mpd_control::get_state() const
 {
-    bool random = get_random();
-    set_random(!random);
+    return _status.load().state;
 }
 
-std::string mpd_control::get_current_title()
+status_info mpd_control::get_status() const
 {
-    return get_current_tag(MPD_TAG_TITLE);
+    return _status.load();
 }
 
-std::string mpd_control::get_current_artist()
+void mpd_control::toggle_random()
 {
-    return get_current_tag(MPD_TAG_ARTIST);
+    bool random = get_random();
+    set_random(!random);
 }
 
-std::string mpd_control::get_current_album()
+static song_info song_info_from_mpd_song(mpd_song const * s)
 {
-    return get_current_tag(MPD_TAG_ALBUM);
+    song_info result;
+    if (s != nullptr)
+    {
+        result.artist = string_from_ptr(mpd_song_get_tag(s, MPD_TAG_ARTIST, 0));
+        result.album = string_from_ptr(mpd_song_get_tag(s, MPD_TAG_ALBUM, 0));
+        result.title = string_from_ptr(mpd_song_get_tag(s, MPD_TAG_TITLE, 0));
+    }
+    return result;
 }
 
 std::string format_playlist_song(mpd_song * s)
@@ -265,94 +396,274 @@ std::string format_playlist_song(mpd_song * s)
            + string_from_ptr(mpd_song_get_tag(s, MPD_TAG_TITLE, 0));
 }
 
-std::pair<std::vector<std::string>, unsigned int> mpd_control::get_current_playlist()
+static std::string_view intern_tag(string_interner & interner, mpd_song * s, mpd_tag_type t)
+{
+    char const * value = mpd_song_get_tag(s, t, 0);
+    return value == nullptr ? std::string_view() : interner.intern(value);
+}
+
+// Tags repeat a lot within a queue, they are interned as they arrive. Paths
+// are unique, interning them would only grow the interner.
+static queue_entry queue_entry_from_mpd_song(mpd_song * s, string_interner & interner)
 {
-    typedef std::pair<std::vector<std::string>, unsigned int> result_type;
+    queue_entry result;
+    result.display = format_playlist_song(s);
+    result.tag(queue_field::ARTIST) = intern_tag(interner, s, MPD_TAG_ARTIST);
+    result.tag(queue_field::ALBUM_ARTIST) = intern_tag(interner, s, MPD_TAG_ALBUM_ARTIST);
+    result.tag(queue_field::ALBUM) = intern_tag(interner, s, MPD_TAG_ALBUM);
+    result.tag(queue_field::TITLE) = intern_tag(interner, s, MPD_TAG_TITLE);
+    result.tag(queue_field::COMPOSER) = intern_tag(interner, s, MPD_TAG_COMPOSER);
+    result.tag(queue_field::GENRE) = intern_tag(interner, s, MPD_TAG_GENRE);
+    result.path = mpd_song_get_uri(s);
+    return result;
+}
 
-    return add_external_task_with_return<result_type>([](mpd_connection * c)
+// Receive the songs of a queue range after the status. Both are sent in one
+// command list to get the version matching the songs.
+static std::optional<queue_range> recv_queue_range(mpd_connection * c, unsigned int start, std::shared_ptr<string_interner> const & interner)
+{
+    mpd_status * status = mpd_recv_status(c);
+    if (status == nullptr || !mpd_response_next(c))
     {
-        mpd_status * status = mpd_run_status(c);
-        std::vector<std::string> playlist;
-        playlist.reserve(mpd_status_get_queue_length(status));
+        if (status != nullptr)
+            mpd_status_free(status);
+        return std::nullopt;
+    }
 
-        mpd_send_list_queue_meta(c);
+    queue_range result { mpd_status_get_queue_version(status), mpd_status_get_queue_length(status), start, {}, interner };
+    mpd_status_free(status);
 
-        mpd_song * song;
-        while ((song = mpd_recv_song(c)) != nullptr)
-        {
-            playlist.push_back(format_playlist_song(song));
-            mpd_song_free(song);
-        }
+    mpd_song * song;
+    while ((song = mpd_recv_song(c)) != nullptr)
+    {
+        result.entries.push_back(queue_entry_from_mpd_song(song, *interner));
+        mpd_song_free(song);
+    }
+
+    if (!mpd_response_finish(c))
+        return std::nullopt;
+    return result;
+}
+
+static std::optional<queue_range> run_queue_range(mpd_connection * c, unsigned int start, unsigned int end, std::shared_ptr<string_interner> const & interner)
+{
+    mpd_command_list_begin(c, true);
+    mpd_send_status(c);
+    mpd_send_list_queue_range_meta(c, start, end);
+    mpd_command_list_end(c);
+    return recv_queue_range(c, start, interner);
+}
 
-        auto version = mpd_status_get_queue_version(status);
-        mpd_status_free(status);
-        return std::make_pair(playlist, version);
+std::optional<queue_song> mpd_control::get_queue_song(unsigned int pos)
+{
+    return _bulk.add_task_with_return<std::optional<queue_song>>([pos](mpd_connection * c) -> std::optional<queue_song>
+    {
+        mpd_song * song = c != nullptr ? mpd_run_get_queue_song_pos(c, pos) : nullptr;
+        if (song == nullptr)
+            return std::nullopt;
+
+        queue_song result{ mpd_song_get_uri(song), song_info_from_mpd_song(song) };
+        mpd_song_free(song);
+        return result;
     });
 }
 
-playlist_change_info mpd_control::get_current_playlist_changes(unsigned int version)
+// A window replaces the queue, its tags are interned from scratch.
+static std::optional<queue_range> run_queue_window(mpd_connection * c, unsigned int size, std::shared_ptr<string_interner> & interner)
 {
-    return add_external_task_with_return<playlist_change_info>([version](mpd_connection * c)
+    if (c == nullptr)
+        return std::nullopt;
+
+    mpd_status * status = mpd_run_status(c);
+    if (status == nullptr)
+        return std::nullopt;
+
+    unsigned int const length = mpd_status_get_queue_length(status);
+    int const song_pos = mpd_status_get_song_pos(status);
+    mpd_status_free(status);
+
+    unsigned int start = song_pos > 0 ? song_pos : 0;
+    start -= std::min(start, size / 2);
+    // Keep the window full at the end of the queue.
+    start = std::min(start, length - std::min(length, size));
+
+    interner = std::make_shared<string_interner>();
+
+    // The queue may have changed in between, then the status sent along is
+    // the one that matches.
+    return run_queue_range(c, start, start + size, interner);
+}
+
+std::optional<queue_range> mpd_control::get_current_queue_window(unsigned int size)
+{
+    return _bulk.add_task_with_return<std::optional<queue_range>>([this, size](mpd_connection * c)
     {
+        return run_queue_window(c, size, _tag_interner);
+    });
+}
 
-        mpd_status * status = mpd_run_status(c);
-        playlist_change_info::diff_type changed_positions;
+void mpd_control::fetch_current_queue_window(unsigned int size, std::function<void(std::optional<queue_range>)> callback)
+{
+    _bulk.add_task([this, size, callback](mpd_connection * c)
+    {
+        callback(run_queue_window(c, size, _tag_interner));
+    });
+}
 
-        mpd_send_queue_changes_meta(c, version);
+void mpd_control::fetch_queue_range(unsigned int start, unsigned int end, std::function<void(std::optional<queue_range>)> callback)
+{
+    _bulk.add_task([this, start, end, callback](mpd_connection * c)
+    {
+        callback(c != nullptr ? run_queue_range(c, start, end, _tag_interner) : std::nullopt);
+    });
+}
 
-        mpd_song * song;
-        while ((song = mpd_recv_song(c)) != nullptr)
+static std::optional<playlist_change_info> run_queue_changes(mpd_connection * c, unsigned int version, std::shared_ptr<string_interner> & interner)
+{
+    mpd_command_list_begin(c, true);
+    mpd_send_status(c);
+    mpd_send_queue_changes_meta(c, version);
+    mpd_command_list_end(c);
+
+    mpd_status * status = mpd_recv_status(c);
+    if (status == nullptr || !mpd_response_next(c))
+    {
+        if (status != nullptr)
+            mpd_status_free(status);
+        return std::nullopt;
+    }
+
+    auto qv = mpd_status_get_queue_version(status);
+    auto ql = mpd_status_get_queue_length(status);
+    mpd_status_free(status);
+
+    playlist_change_info::diff_type changed_positions;
+
+    mpd_song * song;
+    while ((song = mpd_recv_song(c)) != nullptr)
+    {
+        changed_positions.emplace_back(mpd_song_get_pos(song), queue_entry_from_mpd_song(song, *interner));
+        mpd_song_free(song);
+    }
+
+    if (!mpd_response_finish(c))
+        return std::nullopt;
+
+    // If the whole queue was replaced, the tags of the former one are not
+    // needed anymore. Each position is reported once.
+    if (changed_positions.size() == ql)
+    {
+        auto new_interner = std::make_shared<string_interner>();
+        for (auto & p : changed_positions)
         {
-            changed_positions.emplace_back(mpd_song_get_pos(song), format_playlist_song(song));
-            mpd_song_free(song);
+            for (auto & t : p.second.tags)
+                t = new_interner->intern(t);
         }
+        interner = std::move(new_interner);
+    }
+    return playlist_change_info(qv, std::move(changed_positions), ql, interner);
+}
 
-        auto qv = mpd_status_get_queue_version(status);
-        auto ql = mpd_status_get_queue_length(status);
-        mpd_status_free(status);
-        return playlist_change_info(qv, std::move(changed_positions), ql);
+void mpd_control::fetch_playlist_changes(unsigned int version, std::function<void(std::optional<playlist_change_info>)> callback)
+{
+    _bulk.add_task([this, version, callback](mpd_connection * c)
+    {
+        callback(c != nullptr ? run_queue_changes(c, version, _tag_interner) : std::nullopt);
     });
 }
 
-std::string mpd_control::get_current_tag(enum mpd_tag_type type)
+static mpd_tag_type mpd_tag_from_queue_field(queue_field f)
 {
-    std::promise<std::string> promise;
-
-    _external_song_queries.add([type, &promise](mpd_connection * c, mpd_song * s)
+    switch (f)
     {
-        std::string const value = s != nullptr ? string_from_ptr(mpd_song_get_tag(s, type, 0)) : "";
-        promise.set_value(value);
+        case queue_field::ARTIST: return MPD_TAG_ARTIST;
+        case queue_field::ALBUM_ARTIST: return MPD_TAG_ALBUM_ARTIST;
+        case queue_field::ALBUM: return MPD_TAG_ALBUM;
+        case queue_field::TITLE: return MPD_TAG_TITLE;
+        case queue_field::COMPOSER: return MPD_TAG_COMPOSER;
+        case queue_field::GENRE: return MPD_TAG_GENRE;
+        default: return MPD_TAG_UNKNOWN;
     }
-    );
+}
 
-    notify();
+std::vector<library_song> mpd_control::search_library(search_query const & query, unsigned int start, unsigned int end)
+{
+    return _bulk.add_task_with_return<std::vector<library_song>>([&query, start, end](mpd_connection * c)
+    {
+        std::vector<library_song> result;
+
+        // Without a constraint the whole database would be listed.
+        bool const constrained = std::any_of(query.terms.begin(), query.terms.end(), [](search_term const & t)
+        {
+            return !t.folded_value.empty();
+        });
+        if (c == nullptr || !constrained || start >= end)
+            return result;
+
+        // MPD matches case-insensitive substrings as well, the folded terms
+        // are used as they are.
+        mpd_search_db_songs(c, false);
+        for (search_term const & t : query.terms)
+        {
+            if (t.folded_value.empty())
+                continue;
+
+            char const * value = t.folded_value.c_str();
+            if (!t.opt_field.has_value())
+                mpd_search_add_any_tag_constraint(c, MPD_OPERATOR_DEFAULT, value);
+            else if (t.opt_field == queue_field::PATH)
+                mpd_search_add_uri_constraint(c, MPD_OPERATOR_DEFAULT, value);
+            else
+                mpd_search_add_tag_constraint(c, MPD_OPERATOR_DEFAULT, mpd_tag_from_queue_field(t.opt_field.value()), value);
+        }
+        mpd_search_add_window(c, start, end);
 
-    return promise.get_future().get();
+        if (!mpd_search_commit(c))
+            return result;
+
+        mpd_song * song;
+        while ((song = mpd_recv_song(c)) != nullptr)
+        {
+            result.push_back(library_song{ mpd_song_get_uri(song), format_playlist_song(song) });
+            mpd_song_free(song);
+        }
+        mpd_response_finish(c);
+        return result;
+    });
 }
 
 void mpd_control::add_external_task(std::function<void(mpd_connection *)> && t)
 {
-    _external_tasks.add(std::move(t));
+    _external_tasks.add(external_task{ std::move(t), {} });
     notify();
 }
 
-void mpd_control::new_song_cb(mpd_song * s)
+void mpd_control::add_pipelined_task(std::function<void(mpd_connection *)> && send, std::function<void(mpd_connection *, bool)> && receive)
 {
-    _new_song_cb(s != nullptr ? std::make_optional(song_location{ mpd_song_get_uri(s), mpd_song_get_pos(s) }) : std::nullopt);
+    _external_tasks.add(external_task{ std::move(send), std::move(receive) });
+    notify();
 }
 
-std::optional<dynamic_image_data> mpd_control::get_cover(std::string path,
-                                                         bool (* send_fun)(mpd_connection *, char const *, unsigned),
-                                                         int (* recv_fun)(mpd_connection *, void *, size_t),
-                                                         int (* run_fun)(mpd_connection *, char const *, unsigned, void *, size_t))
+void mpd_control::new_song_cb(mpd_song * s)
 {
-    std::promise<std::optional<dynamic_image_data>> result;
-
-    byte_buffer buffer;
-    size_t current_offset = 0;
+    _new_song_cb( s != nullptr ? std::make_optional(song_location{ mpd_song_get_uri(s), mpd_song_get_pos(s) }) : std::nullopt
+                , song_info_from_mpd_song(s)
+                );
+}
 
-    add_external_task([this, &result, &buffer, &current_offset, &path, send_fun, recv_fun, run_fun](mpd_connection * c)
+cover_transfer mpd_control::get_cover(std::string path,
+                                      std::function<bool()> const & cancelled,
+                                      bool (* send_fun)(mpd_connection *, char const *, unsigned),
+                                      int (* recv_fun)(mpd_connection *, void *, size_t),
+                                      int (* run_fun)(mpd_connection *, char const *, unsigned, void *, size_t))
+{
+    return _bulk.add_task_with_return<cover_transfer>([&path, &cancelled, send_fun, recv_fun, run_fun](mpd_connection * c) -> cover_transfer
     {
+        cover_transfer const failed { std::nullopt, false };
+        if (c == nullptr)
+            return failed;
+
+        byte_buffer buffer;
         size_t size = 0;
         send_fun(c, path.c_str(), 0);
         mpd_pair * pair = mpd_recv_pair(c);
@@ -367,64 +678,46 @@ std::optional<dynamic_image_data> mpd_control::get_cover(std::string path,
             }
             mpd_return_pair(c, pair);
         }
-        else
-        {
-            mpd_connection_clear_error(c);
-        }
 
-        if (size != 0)
+        // MPD either replies with an error or without data if there is no
+        // cover, anything else is a failed transfer.
+        if (size == 0)
         {
-            int read_bytes = recv_fun(c, buffer.data(), buffer.size());
-            current_offset += read_bytes;
-            if (mpd_response_finish(c))
-            {
-                handle_read_cover_chunk_result(result, buffer, current_offset, path, run_fun, read_bytes);
-                return;
-            }
+            mpd_error const error = mpd_connection_get_error(c);
+            return cover_transfer{ std::nullopt, error == MPD_ERROR_SUCCESS || error == MPD_ERROR_SERVER };
         }
-        result.set_value(std::nullopt);
-    });
 
-    return result.get_future().get();
-}
+        int read_bytes = recv_fun(c, buffer.data(), buffer.size());
+        if (read_bytes <= 0 || !mpd_response_finish(c))
+            return failed;
 
-void mpd_control::handle_read_cover_chunk_result(std::promise<std::optional<dynamic_image_data>> & result, byte_buffer & buffer, size_t & current_offset, std::string const & path,
-                                                 int (* run_fun)(mpd_connection *, char const *, unsigned, void *, size_t), int read_bytes)
-{
-    if (read_bytes < 0)
-    {
-        result.set_value(std::nullopt);
-    }
-    else if (current_offset == buffer.size())
-    {
-        result.set_value(std::make_optional<dynamic_image_data>(buffer, current_offset));
-    }
-    else
-    {
-        add_external_task([this, &result, &buffer, &current_offset, &path, run_fun](mpd_connection * c)
+        // Chunks are requested one after another, nothing else is waiting
+        // for this connection.
+        size_t current_offset = read_bytes;
+        while (current_offset < buffer.size())
         {
-            read_cover_chunk(c, result, buffer, current_offset, path, run_fun);
-        });
-    }
-}
+            if (cancelled())
+                return failed;
 
-void mpd_control::read_cover_chunk(mpd_connection * c, std::promise<std::optional<dynamic_image_data>> & result, byte_buffer & buffer, size_t & current_offset, std::string const & path,
-                             int (* run_fun)(mpd_connection *, char const *, unsigned, void *, size_t))
-{
-    int read_bytes =
-        run_fun(c, path.c_str(), current_offset,
-                buffer.data() + current_offset,
-                buffer.size() - current_offset);
-    current_offset += read_bytes;
-    handle_read_cover_chunk_result(result, buffer, current_offset, path, run_fun, read_bytes);
+            read_bytes = run_fun(c, path.c_str(), current_offset,
+                                 buffer.data() + current_offset,
+                                 buffer.size() - current_offset);
+            if (read_bytes <= 0)
+                return failed;
+
+            current_offset += read_bytes;
+        }
+
+        return cover_transfer{ std::make_optional<dynamic_image_data>(buffer, current_offset), true };
+    });
 }
 
-std::optional<dynamic_image_data> mpd_control::get_albumart(std::string path)
+cover_transfer mpd_control::get_albumart(std::string path, std::function<bool()> cancelled)
 {
-    return get_cover(path, &mpd_send_albumart, &mpd_recv_albumart, &mpd_run_albumart);
+    return get_cover(path, cancelled, &mpd_send_albumart, &mpd_recv_albumart, &mpd_run_albumart);
 }
 
-std::optional<dynamic_image_data> mpd_control::get_readpicture(std::string path)
+cover_transfer mpd_control::get_readpicture(std::string path, std::function<bool()> cancelled)
 {
-    return get_cover(path, &mpd_send_readpicture, &mpd_recv_readpicture, &mpd_run_readpicture);
+    return get_cover(path, cancelled, &mpd_send_readpicture, &mpd_recv_readpicture, &mpd_run_readpicture);
 }
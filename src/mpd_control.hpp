@@ -5,7 +5,9 @@
 #ifndef MPD_CONTROL_HPP
 #define MPD_CONTROL_HPP
 
+#include <atomic>
 #include <functional>
+#include <memory>
 #include <mutex>
 #include <queue>
 #include <future>
@@ -13,66 +15,82 @@
 
 #include <mpd/client.h>
 
+#include "atomic_snapshot.hpp"
 #include "dynamic_image_data.hpp"
+#include "mpd_bulk_connection.hpp"
+#include "queue_entry.hpp"
+#include "search_query.hpp"
+#include "song_info.hpp"
+#include "string_interner.hpp"
 
 #if defined(HAVE_POLL_H) && defined(HAVE_SYS_EVENTFD_H) && defined(HAVE_UNISTD_H)
 #pragma message ( "Compiling with eventfd polling support." )
 #define USE_POLL
 #endif
 
-template <typename F>
-class callback_deque
+// A task for the MPD thread. Tasks with a receive function are pipelined:
+// consecutive ones are sent within a single command list and their replies
+// are received afterwards. Tasks without one do all their work in send.
+struct external_task
+{
+    std::function<void(mpd_connection *)> send;
+
+    // Receives the reply to what has been sent. The flag is false if the
+    // command list has been aborted before, in that case the connection must
+    // not be used. A task that sends several commands has to advance to the
+    // next reply with mpd_response_next.
+    std::function<void(mpd_connection *, bool)> receive;
+
+    bool is_pipelined() const;
+};
+
+template <typename T>
+class task_deque
 {
-    typedef std::deque<std::function<F>> deque_type;
     std::mutex _mutex;
 
-    deque_type _active_deque;
-    deque_type _buffer_deque;
+    std::deque<T> _deque;
 
     public:
 
-    void add(std::function<F> && f)
+    void add(T && t)
     {
         std::scoped_lock lock(_mutex);
-        _active_deque.push_back(f);
+        _deque.push_back(std::move(t));
     }
 
-    template <typename... Args>
-    void run(Args... args)
+    // Move all queued elements into the given (empty) deque at once to keep
+    // locking time to a minimum.
+    bool take_all(std::deque<T> & result)
     {
-        // Keep locking time to a minimum by swapping out queues and because of
-        // that callbacks can add new callbacks that are not executed in the
-        // same batch.
-        {
-            std::scoped_lock lock(_mutex);
-            if (_active_deque.empty())
-            {
-                return;
-            }
-            else
-            {
-                _active_deque.swap(_buffer_deque);
-            }
-        }
-
-        do
-        {
-            _buffer_deque.front()(args...);
-            _buffer_deque.pop_front();
-        }
-        while (!_buffer_deque.empty());
+        std::scoped_lock lock(_mutex);
+        _deque.swap(result);
+        return !result.empty();
     }
 };
 
 struct playlist_change_info
 {
-    typedef std::vector<std::pair<unsigned int, std::string>> diff_type;
+    typedef std::vector<std::pair<unsigned int, queue_entry>> diff_type;
 
-    playlist_change_info(int nv, diff_type && cp, unsigned int l);
+    playlist_change_info(int nv, diff_type && cp, unsigned int l, std::shared_ptr<string_interner> ti);
 
     unsigned int new_version;
     diff_type changed_positions;
     unsigned int new_length;
+    // the interner of the tags of the changed entries
+    std::shared_ptr<string_interner> tag_interner;
+};
+
+// Consecutive songs of the queue and the state of the queue they belong to.
+struct queue_range
+{
+    unsigned int version;
+    unsigned int length;
+    unsigned int start;
+    std::vector<queue_entry> entries;
+    // the interner of the tags of the entries
+    std::shared_ptr<string_interner> tag_interner;
 };
 
 struct song_location
@@ -81,14 +99,36 @@ struct song_location
     unsigned int pos;
 };
 
+struct queue_song
+{
+    std::string path;
+    song_info info;
+};
+
+// The outcome of a cover transfer. Without data, complete tells whether MPD
+// reported that there is no cover, as opposed to a failed or cancelled
+// transfer.
+struct cover_transfer
+{
+    std::optional<dynamic_image_data> opt_data;
+    bool complete;
+};
+
+// A snapshot of the player status as last reported by MPD.
 struct status_info
 {
+    // -1 if there is no mixer
+    int volume = -1;
+    mpd_state state = MPD_STATE_UNKNOWN;
+    bool random = false;
+    // -1 if there is no next song (e.g., at the end of the queue)
+    int next_song_pos = -1;
 };
 
 struct mpd_control
 {
     mpd_control
-        ( std::function<void(std::optional<song_location>)> new_song_cb
+        ( std::function<void(std::optional<song_location>, song_info)> new_song_cb
         , std::function<void(bool)> random_cb
         , std::function<void()> playlist_changed_cb
         , std::function<void(mpd_state)> playback_state_changed_cb
@@ -106,43 +146,75 @@ struct mpd_control
 
     void play_position(int pos);
 
+    // Append the song with the given path to the queue and play it.
+    void add_and_play(std::string path);
+
     void set_random(bool value);
-    bool get_random();
+    bool get_random() const;
     void toggle_random();
 
-    mpd_state get_state();
+    mpd_state get_state() const;
 
-    std::string get_current_title();
-    std::string get_current_artist();
-    std::string get_current_album();
+    // Never blocks, the status is kept up to date by idle events.
+    status_info get_status() const;
 
-    std::pair<std::vector<std::string>, unsigned int> get_current_playlist();
+    // Looked up on the bulk connection, nothing if there is no such song.
+    std::optional<queue_song> get_queue_song(unsigned int pos);
 
-    playlist_change_info get_current_playlist_changes(unsigned int version);
+    // Transferred on the bulk connection. At most size songs around the
+    // current one.
+    std::optional<queue_range> get_current_queue_window(unsigned int size);
 
-    std::optional<dynamic_image_data> get_albumart(std::string path);
-    std::optional<dynamic_image_data> get_readpicture(std::string path);
+    // The same in the background, the callback is called from another thread.
+    // It is given nothing if there is no connection or the transfer failed.
+    void fetch_current_queue_window(unsigned int size, std::function<void(std::optional<queue_range>)> callback);
+
+    // Transferred on the bulk connection, the callback is called from another
+    // thread. It is given nothing if there is no connection or the transfer
+    // failed.
+    void fetch_queue_range(unsigned int start, unsigned int end, std::function<void(std::optional<queue_range>)> callback);
+
+    // Transferred on the bulk connection like the ranges, the callback is
+    // called from another thread. It is given nothing if there is no
+    // connection or the transfer failed.
+    void fetch_playlist_changes(unsigned int version, std::function<void(std::optional<playlist_change_info>)> callback);
+
+    // Search the database on the bulk connection and return the songs in the
+    // window [start, end). An empty query finds nothing.
+    std::vector<library_song> search_library(search_query const & query, unsigned int start, unsigned int end);
+
+    // Transferred on the bulk connection. The transfer is aborted between
+    // chunks if it is cancelled.
+    cover_transfer get_albumart(std::string path, std::function<bool()> cancelled);
+    cover_transfer get_readpicture(std::string path, std::function<bool()> cancelled);
 
     private:
 
     // wait for next event
     void wait();
 
+    // Fetch the status and, if necessary, the current song in one round-trip.
+    // Publishes the new status and emits the callbacks for the idle event.
+    void handle_idle_event(int idle_event, bool initial, mpd_song * & last_song);
+
     // wake up event loop to handle local events
     void notify();
 
-    std::optional<dynamic_image_data> get_cover(std::string path,
-                                                bool (* send_fun)(mpd_connection *, char const *, unsigned),
-                                                int (* recv_fun)(mpd_connection *, void *, size_t),
-                                                int (* run_fun)(mpd_connection *, char const *, unsigned, void *, size_t));
-    void read_cover_chunk(mpd_connection * c, std::promise<std::optional<dynamic_image_data>> & result, byte_buffer & buffer, size_t & current_offset, std::string const & path,
-                          int (* run_fun)(mpd_connection *, char const *, unsigned, void *, size_t));
-    void handle_read_cover_chunk_result(std::promise<std::optional<dynamic_image_data>> & result, byte_buffer & buffer, size_t & current_offset, std::string const & path,
-                                        int (* run_fun)(mpd_connection *, char const *, unsigned, void *, size_t), int read_bytes);
+    // run all queued tasks in order, pipelined tasks are batched
+    void run_external_tasks();
+    void run_command_list(std::deque<external_task>::iterator begin, std::deque<external_task>::iterator end);
 
-    std::string get_current_tag(enum mpd_tag_type type);
+    cover_transfer get_cover(std::string path,
+                             std::function<bool()> const & cancelled,
+                             bool (* send_fun)(mpd_connection *, char const *, unsigned),
+                             int (* recv_fun)(mpd_connection *, void *, size_t),
+                             int (* run_fun)(mpd_connection *, char const *, unsigned, void *, size_t));
+
+    // Set the volume relative to the status snapshot.
+    void change_volume(mpd_connection * c, int delta);
 
     void add_external_task(std::function<void(mpd_connection *)> && t);
+    void add_pipelined_task(std::function<void(mpd_connection *)> && send, std::function<void(mpd_connection *, bool)> && receive);
 
     template <typename R>
     R add_external_task_with_return(std::function<R(mpd_connection *)> && f)
@@ -155,19 +227,43 @@ struct mpd_control
         return promise.get_future().get();
     }
 
+    template <typename R>
+    R add_pipelined_task_with_return(std::function<void(mpd_connection *)> && send, std::function<R(mpd_connection *, bool)> && receive)
+    {
+        std::promise<R> promise;
+        add_pipelined_task(std::move(send), [&promise, receive = std::move(receive)](mpd_connection * c, bool ok)
+        {
+            promise.set_value(receive(c, ok));
+        });
+        return promise.get_future().get();
+    }
+
     void new_song_cb(mpd_song * s);
 
     mpd_connection * _c;
 
+    // Tags of fetched queue entries refer to it. Only used on the bulk
+    // connection. Replaced along with the queue, the former one is kept alive
+    // by the entries that refer to it.
+    std::shared_ptr<string_interner> _tag_interner;
+
+    // for transfers that would otherwise block the connection above
+    mpd_bulk_connection _bulk;
+
     bool _run;
 
-    std::function<void(std::optional<song_location>)> _new_song_cb;
+    atomic_snapshot<status_info> _status;
+
+    // accumulated volume changes that have not been sent yet
+    std::atomic<int> _pending_volume_delta;
+
+    std::function<void(std::optional<song_location>, song_info)> _new_song_cb;
     std::function<void(bool)> _random_cb;
     std::function<void()> _playlist_changed_cb;
     std::function<void(mpd_state)> _playback_state_changed_cb;
 
-    callback_deque<void(mpd_connection *)> _external_tasks;
-    callback_deque<void(mpd_connection *, mpd_song *)> _external_song_queries;
+    task_deque<external_task> _external_tasks;
+    std::deque<external_task> _current_tasks;
 
 #ifdef USE_POLL
     // a file descriptor for thread communication
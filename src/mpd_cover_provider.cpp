@@ -13,14 +13,19 @@ mpd_cover_provider::mpd_cover_provider(mpd_control & mpd_control, mpd_cover_type
 bool mpd_cover_provider::update_cover(cover_updatable & u, song_data_provider const & p) const
 {
     auto path = p.get_song_path();
-    auto opt_image_data =
-        _type == MPD_COVER_TYPE_ALBUMART ? _mpd_control.get_albumart(path)
-                                         : _mpd_control.get_readpicture(path);
-    bool found = opt_image_data.has_value();
+    auto cancelled = [&u](){ return u.is_cancelled(); };
+    auto transfer =
+        _type == MPD_COVER_TYPE_ALBUMART ? _mpd_control.get_albumart(path, cancelled)
+                                         : _mpd_control.get_readpicture(path, cancelled);
+    bool found = transfer.opt_data.has_value();
 
     if (found)
     {
-        u.update_cover_from_image_data(opt_image_data.value());
+        u.update_cover_from_image_data(transfer.opt_data.value());
+    }
+    else if (!transfer.complete)
+    {
+        u.update_cover_failed();
     }
 
     return found;
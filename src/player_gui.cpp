@@ -6,6 +6,7 @@
 #include <libwtk-sdl2/sdl_util.hpp>
 
 #include "player_gui.hpp"
+#include "surface_util.hpp"
 #include "widget_util.hpp"
 
 #ifndef ICONDIR
@@ -28,7 +29,7 @@ void player_gui::advance_view()
     _view_ptr->set_page((_view_ptr->get_page() + 1) % 4);
 }
 
-player_gui::player_gui(SDL_Renderer * renderer, player_model & model, std::vector<std::string> & playlist, unsigned int & current_song_pos, program_config const & cfg)
+player_gui::player_gui(SDL_Renderer * renderer, player_model & model, std::vector<std::string> & playlist, search_index const & playlist_index, unsigned int & current_song_pos, program_config const & cfg, std::function<void(std::function<void()>)> post)
     : _renderer(renderer)
     , _model(model)
     , _cover_view_ptr(std::make_shared<cover_view>( [&](swipe_direction dir){ handle_cover_swipe_direction(dir); }
@@ -42,7 +43,10 @@ player_gui::player_gui(SDL_Renderer * renderer, player_model & model, std::vecto
                                                     , cfg.on_screen_keyboard.size
                                                     , cfg.on_screen_keyboard.keys
                                                     , playlist
-                                                    , [&](auto pos){ _model.play_position(pos); }
+                                                    , playlist_index
+                                                    , model
+                                                    , cfg.search
+                                                    , post
                                                     ))
     , _view_ptr(std::make_shared<notebook>(
           std::vector<widget_ptr>{ _cover_view_ptr
@@ -109,7 +113,7 @@ void player_gui::handle_cover_swipe_direction(swipe_direction dir)
 
 void player_gui::on_cover_updated(std::string cover_path)
 {
-    update_cover_from_local_file(cover_path);
+    update_cover_from_surface(load_fitted_surface_from_file(cover_path, get_cover_size()).get());
 }
 
 void player_gui::on_cover_updated(std::string title, std::string artist, std::string album)
@@ -127,9 +131,9 @@ void player_gui::on_song_changed(unsigned int new_song_position)
     _search_view_ptr->set_filtered_highlight_position(new_song_position);
 }
 
-void player_gui::on_playlist_changed(bool reset_position)
+void player_gui::on_playlist_changed(bool reset_position, std::vector<std::size_t> const & changed_positions)
 {
-    _search_view_ptr->on_playlist_changed();
+    _search_view_ptr->on_playlist_changed(changed_positions);
 
     if (reset_position)
     {
@@ -181,18 +185,18 @@ void player_gui::on_draw_dirty_event()
     _ctx.draw_dirty();
 }
 
-void player_gui::update_cover_from_local_file(std::string filename)
+vec player_gui::get_cover_size() const
 {
-    _cover_view_ptr->set_cover(std::move(load_texture_from_file(_renderer, filename)));
+    return _cover_view_ptr->get_cover_size();
 }
 
-void player_gui::update_cover_from_song_info(song_info const & info)
+void player_gui::update_cover_from_surface(SDL_Surface * surface)
 {
-    _cover_view_ptr->set_cover(info.title, info.artist, info.album);
+    _cover_view_ptr->set_cover(unique_texture_ptr(SDL_CreateTextureFromSurface(_renderer, surface)));
 }
 
-void player_gui::update_cover_from_image_data(byte_array_slice data)
+void player_gui::update_cover_from_song_info(song_info const & info)
 {
-    _cover_view_ptr->set_cover(std::move(load_texture_from_memory(_renderer, data)));
+    _cover_view_ptr->set_cover(info.title, info.artist, info.album);
 }
 
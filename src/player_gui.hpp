@@ -20,13 +20,14 @@
 
 struct player_gui : player_view
 {
-    player_gui(SDL_Renderer * renderer, player_model & model, std::vector<std::string> & playlist, unsigned int & current_song_pos, program_config const & cfg);
+    // Post has to run the given function on the thread of the GUI.
+    player_gui(SDL_Renderer * renderer, player_model & model, std::vector<std::string> & playlist, search_index const & playlist_index, unsigned int & current_song_pos, program_config const & cfg, std::function<void(std::function<void()>)> post);
 
     void on_cover_updated(std::string cover_path);
     void on_cover_updated(std::string title, std::string artist, std::string album);
 
     void on_song_changed(unsigned int new_song_position);
-    void on_playlist_changed(bool reset_position);
+    void on_playlist_changed(bool reset_position, std::vector<std::size_t> const & changed_positions);
     void on_random_changed(bool random);
     void on_playback_state_changed(mpd_state playback_state);
 
@@ -34,9 +35,9 @@ struct player_gui : player_view
     void on_other_event(SDL_Event const & e);
     void on_draw_dirty_event();
 
-    void update_cover_from_local_file(std::string filename);
+    vec get_cover_size() const;
+    void update_cover_from_surface(SDL_Surface * surface);
     void update_cover_from_song_info(song_info const & info);
-    void update_cover_from_image_data(byte_array_slice data);
 
     private:
 
@@ -4,6 +4,13 @@
 
 #pragma once
 
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "queue_entry.hpp"
+#include "search_query.hpp"
+
 struct player_model
 {
     virtual void inc_volume(unsigned int volume_step) = 0;
@@ -14,6 +21,11 @@ struct player_model
     virtual void toggle_random() = 0;
 
     virtual void play_position(std::size_t pos) = 0;
+    virtual void add_and_play(std::string path) = 0;
+
+    // Blocks until the songs in the window [start, end) arrived, may be
+    // called from any thread.
+    virtual std::vector<library_song> search_library(search_query const & query, unsigned int start, unsigned int end) = 0;
 
     virtual void shutdown() = 0;
     virtual void reboot() = 0;
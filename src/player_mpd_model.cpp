@@ -45,6 +45,16 @@ void player_mpd_model::play_position(std::size_t pos)
     _mpd_control.play_position(pos);
 }
 
+void player_mpd_model::add_and_play(std::string path)
+{
+    _mpd_control.add_and_play(path);
+}
+
+std::vector<library_song> player_mpd_model::search_library(search_query const & query, unsigned int start, unsigned int end)
+{
+    return _mpd_control.search_library(query, start, end);
+}
+
 void player_mpd_model::shutdown()
 {
     _quit_action = quit_action::SHUTDOWN;
@@ -24,6 +24,9 @@ struct player_mpd_model : player_model
     void toggle_random();
 
     void play_position(std::size_t pos);
+    void add_and_play(std::string path);
+
+    std::vector<library_song> search_library(search_query const & query, unsigned int start, unsigned int end);
 
     void shutdown();
     void reboot();
@@ -4,6 +4,9 @@
 
 #pragma once
 
+#include <cstddef>
+#include <vector>
+
 #include <SDL2/SDL.h>
 
 // mpd_state
@@ -12,19 +15,25 @@
 #include "cover_view.hpp"
 // TODO split into type and sender
 #include "navigation_event.hpp"
-#include "cover_updatable.hpp"
+#include "song_info.hpp"
 
-struct player_view : cover_updatable
+struct player_view
 {
     virtual void on_cover_updated(std::string cover_path) = 0;
     virtual void on_cover_updated(std::string title, std::string artist, std::string album) = 0;
 
     virtual void on_song_changed(unsigned int new_song_position) = 0;
-    virtual void on_playlist_changed(bool reset_position) = 0;
+    // The changed positions are within the new length of the playlist.
+    virtual void on_playlist_changed(bool reset_position, std::vector<std::size_t> const & changed_positions) = 0;
     virtual void on_random_changed(bool random) = 0;
     virtual void on_playback_state_changed(mpd_state playback_state) = 0;
 
     virtual void on_navigation_event(navigation_event const & ne) = 0;
     virtual void on_other_event(SDL_Event const & e) = 0;
     virtual void on_draw_dirty_event() = 0;
+
+    // Covers are decoded elsewhere, only the texture is created here.
+    virtual vec get_cover_size() const = 0;
+    virtual void update_cover_from_surface(SDL_Surface * surface) = 0;
+    virtual void update_cover_from_song_info(song_info const & info) = 0;
 };
@@ -2,6 +2,7 @@
 //
 // SPDX-License-Identifier: LGPL-3.0-or-later
 
+#include <algorithm>
 #include <cstdlib>
 #include <vector>
 #include <libconfig.h++>
@@ -90,6 +91,21 @@ bool parse_cover_config(libconfig::Setting & s, cover_config & result)
     // Leave empty if it does not exist.
     parse_string_vector(s.lookup("sources"), result.sources);
 
+    int memory_cache_kib;
+    result.memory_cache_size = s.lookupValue("memory_cache_kib", memory_cache_kib)
+                               ? static_cast<std::size_t>(std::max(0, memory_cache_kib)) * 1024
+                               : 8 * 1024 * 1024;
+
+    if (!s.lookupValue("disk_cache", result.disk_cache))
+    {
+        result.disk_cache = true;
+    }
+
+    int disk_cache_mib;
+    result.disk_cache_size = s.lookupValue("disk_cache_mib", disk_cache_mib)
+                             ? static_cast<std::size_t>(std::max(0, disk_cache_mib)) * 1024 * 1024
+                             : 64 * 1024 * 1024;
+
     return true;
 }
 
@@ -99,6 +115,26 @@ bool parse_on_screen_keyboard_config(libconfig::Setting & s, on_screen_keyboard_
         && s.lookupValue("keys", result.keys);
 }
 
+bool parse_search_config(libconfig::Setting & s, search_config & result)
+{
+    if (!s.lookupValue("trigram_index", result.trigram_index))
+    {
+        result.trigram_index = true;
+    }
+
+    if (!s.lookupValue("fuzzy", result.fuzzy))
+    {
+        result.fuzzy = true;
+    }
+
+    if (!s.lookupValue("library_limit", result.library_limit))
+    {
+        result.library_limit = 1000;
+    }
+
+    return true;
+}
+
 bool parse_font(libconfig::Setting & s, font & result)
 {
     return s.lookupValue("path", result.path)
@@ -117,6 +153,15 @@ bool parse_program_config(boost::filesystem::path config_path, program_config &
         result.opt_port = tmp;
     }
 
+    // The section is optional.
+    result.search.trigram_index = true;
+    result.search.fuzzy = true;
+    result.search.library_limit = 1000;
+    if (program_setting.exists("search") && !parse_search_config(program_setting.lookup("search"), result.search))
+    {
+        return false;
+    }
+
     return parse_font(program_setting.lookup("default_font"), result.default_font)
         && parse_font(program_setting.lookup("big_font"), result.big_font)
         && parse_display_config(program_setting.lookup("display"), result.display)
@@ -50,6 +50,11 @@ struct cover_config
 {
     std::vector<std::string> sources;
     std::optional<filesystem_cover_provider_config> opt_filesystem_cover_provider;
+    // in bytes
+    std::size_t memory_cache_size;
+    bool disk_cache;
+    // in bytes
+    std::size_t disk_cache_size;
 };
 
 struct on_screen_keyboard_config
@@ -58,6 +63,15 @@ struct on_screen_keyboard_config
     std::string keys;
 };
 
+struct search_config
+{
+    bool trigram_index;
+    // rank entries with typos if nothing matches exactly
+    bool fuzzy;
+    // maximum number of songs shown by a library search
+    unsigned int library_limit;
+};
+
 struct program_config
 {
     font default_font;
@@ -70,6 +84,7 @@ struct program_config
     //swipe_config swipe;
     cover_config cover;
     on_screen_keyboard_config on_screen_keyboard;
+    search_config search;
 
     std::optional<int> opt_port;
 };
@@ -0,0 +1,58 @@
+// SPDX-FileCopyrightText: Moritz Bruder <muesli4 at gmail dot com>
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+// The tags of a queue entry that can be searched.
+enum class queue_field
+{
+    ARTIST,
+    ALBUM_ARTIST,
+    ALBUM,
+    TITLE,
+    COMPOSER,
+    GENRE,
+    PATH
+};
+
+constexpr std::size_t QUEUE_FIELD_COUNT = 7;
+
+// The fields before the path are tags.
+constexpr std::size_t QUEUE_TAG_COUNT = 6;
+
+struct queue_entry
+{
+    // as shown in the queue
+    std::string display;
+
+    // Unique per song, so it is not interned.
+    std::string path;
+
+    // Indexed by queue_field, empty if the tag is missing. The fetched values
+    // are interned, they refer to the interner passed along with them.
+    std::array<std::string_view, QUEUE_TAG_COUNT> tags;
+
+    std::string_view field(queue_field f) const
+    {
+        return f == queue_field::PATH ? std::string_view(path) : tags[static_cast<std::size_t>(f)];
+    }
+
+    // Any field but the path.
+    std::string_view & tag(queue_field f)
+    {
+        return tags[static_cast<std::size_t>(f)];
+    }
+};
+
+// A song of the database as found by a library search.
+struct library_song
+{
+    std::string path;
+    std::string display;
+};
@@ -0,0 +1,189 @@
+// SPDX-FileCopyrightText: Moritz Bruder <muesli4 at gmail dot com>
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+// Compares the ASCII fast paths used for searching with the general ones:
+// folding with and without ICU, and substring search with and without
+// vectorization. The baseline is the former search, which converted every
+// entry to ICU, lowercased it, and searched it there. Also measures the fuzzy
+// search with a misspelled term and an update that changes a few entries, with
+// and without trigram index. Build with 'make search-benchmark', configure with
+// --enable-allocation-counter to count allocations of updates.
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <unicode/unistr.h>
+
+#include "allocation_counter.hpp"
+#include "search_index.hpp"
+#include "text_match.hpp"
+#include "worker_pool.hpp"
+
+template <typename F>
+static void measure(char const * name, F f)
+{
+    auto const start = std::chrono::steady_clock::now();
+    std::size_t const checksum = f();
+    auto const end = std::chrono::steady_clock::now();
+
+    std::cout << name << ": "
+              << std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() << " µs"
+              << " (" << checksum << ")" << std::endl;
+}
+
+static std::vector<std::string> make_entries(std::size_t count)
+{
+    static char const * const words[] =
+        { "The", "Beatles", "Pink", "Floyd", "Dark", "Side", "of", "the", "Moon"
+        , "Love", "Night", "Symphony", "No.", "Live", "Remastered", "Blue", "Song"
+        };
+
+    std::mt19937 gen(42);
+    std::uniform_int_distribution<std::size_t> word_dist(0, std::size(words) - 1);
+    std::uniform_int_distribution<int> length_dist(3, 8);
+
+    std::vector<std::string> entries(count);
+    for (auto & e : entries)
+    {
+        int const length = length_dist(gen);
+        for (int i = 0; i < length; ++i)
+        {
+            if (i == 2)
+                e += " - ";
+            else if (i != 0)
+                e += ' ';
+            e += words[word_dist(gen)];
+        }
+    }
+    return entries;
+}
+
+// Swaps a few entries, the cost should not depend on the number of entries.
+static void measure_updates(char const * name, search_index & index, std::vector<queue_entry> const & queue)
+{
+    constexpr std::size_t changes = 10;
+    for (int round = 0; round < 2; ++round)
+    {
+        search_index::diff_type diff;
+        for (std::size_t i = 0; i < changes && i < queue.size(); ++i)
+            diff.emplace_back(i * (queue.size() / changes), queue[(i + round + 1) % queue.size()]);
+
+#ifdef COUNT_ALLOCATIONS
+        std::size_t const allocations_before = allocation_count();
+#endif
+        measure(name, [&]()
+        {
+            index.update(queue.size(), diff, nullptr);
+            return index.size();
+        });
+#ifdef COUNT_ALLOCATIONS
+        std::cout << "allocations: " << allocation_count() - allocations_before << std::endl;
+#else
+        std::cout << "allocations: not counted" << std::endl;
+#endif
+    }
+}
+
+int main(int argc, char ** argv)
+{
+    std::size_t const count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 100000;
+    std::string const term = argc > 2 ? argv[2] : "side of";
+    std::string const misspelled_term = argc > 3 ? argv[3] : "symphnoy";
+
+    std::vector<std::string> const entries = make_entries(count);
+    std::cout << count << " entries, searching for '" << term << '\'' << std::endl;
+
+    std::vector<std::string> folded;
+    measure("fold with ICU", [&]()
+    {
+        folded.clear();
+        for (auto const & e : entries)
+            folded.push_back(search_index::fold_unicode(e));
+        return folded.size();
+    });
+    measure("fold with ASCII fast path", [&]()
+    {
+        folded.clear();
+        for (auto const & e : entries)
+            folded.push_back(search_index::fold(e));
+        return folded.size();
+    });
+
+    std::string buffer;
+    for (auto const & f : folded)
+    {
+        buffer += f;
+        buffer.push_back('\0');
+    }
+    std::string const folded_term = search_index::fold(term);
+
+    constexpr int repetitions = 20;
+    measure("ICU toLower and indexOf (former search)", [&]()
+    {
+        icu::UnicodeString const us_term = icu::UnicodeString::fromUTF8(folded_term);
+        std::size_t matches = 0;
+        for (int i = 0; i < repetitions; ++i)
+        {
+            for (auto const & e : entries)
+            {
+                icu::UnicodeString const us = icu::UnicodeString::fromUTF8(e).toLower();
+                for (int32_t offset = 0; (offset = us.indexOf(us_term, offset)) != -1; ++offset)
+                    matches++;
+            }
+        }
+        return matches;
+    });
+    measure("std::string_view::find", [&]()
+    {
+        std::string_view const b(buffer);
+        std::size_t matches = 0;
+        for (int i = 0; i < repetitions; ++i)
+        {
+            for (std::size_t offset = 0; (offset = b.find(folded_term, offset)) != std::string_view::npos; ++offset)
+                matches++;
+        }
+        return matches;
+    });
+    measure("find_substring", [&]()
+    {
+        std::size_t matches = 0;
+        for (int i = 0; i < repetitions; ++i)
+        {
+            for (std::size_t offset = 0; (offset = find_substring(buffer, folded_term, offset)) != std::string_view::npos; ++offset)
+                matches++;
+        }
+        return matches;
+    });
+
+    std::vector<queue_entry> queue(entries.size());
+    for (std::size_t i = 0; i < entries.size(); ++i)
+        queue[i].tag(queue_field::TITLE) = entries[i];
+
+    search_index index;
+    index.assign(queue, nullptr);
+    search_query const misspelled_query = search_query::parse(misspelled_term);
+    std::cout << "fuzzy search for '" << misspelled_term << '\'' << std::endl;
+
+    measure("find_fuzzy", [&]()
+    {
+        return index.find_fuzzy(misspelled_query, 100, nullptr, {})->size();
+    });
+    worker_pool pool(3);
+    measure("find_fuzzy with 4 threads", [&]()
+    {
+        return index.find_fuzzy(misspelled_query, 100, &pool, {})->size();
+    });
+
+    search_index trigram_index(true);
+    trigram_index.assign(queue, nullptr);
+
+    measure_updates("update of 10 entries", index, queue);
+    measure_updates("update of 10 entries with trigrams", trigram_index, queue);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,867 @@
+// SPDX-FileCopyrightText: Moritz Bruder <muesli4 at gmail dot com>
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include <algorithm>
+#include <climits>
+#include <iterator>
+#include <tuple>
+
+#include <unicode/normalizer2.h>
+#include <unicode/unistr.h>
+
+#include "search_index.hpp"
+#include "text_match.hpp"
+
+static std::uint32_t trigram_at(std::string_view s, std::size_t i)
+{
+    return static_cast<std::uint32_t>(static_cast<unsigned char>(s[i])) << 16
+         | static_cast<std::uint32_t>(static_cast<unsigned char>(s[i + 1])) << 8
+         | static_cast<std::uint32_t>(static_cast<unsigned char>(s[i + 2]));
+}
+
+std::size_t search_index::posting_list::block::decode(std::size_t * positions) const
+{
+    std::size_t n = 0;
+    std::size_t pos = 0;
+    std::size_t delta = 0;
+    unsigned int shift = 0;
+    for (std::uint8_t b : data)
+    {
+        delta |= static_cast<std::size_t>(b & 0x7f) << shift;
+        if (b & 0x80)
+        {
+            shift += 7;
+        }
+        else
+        {
+            pos += delta;
+            positions[n++] = pos;
+            delta = 0;
+            shift = 0;
+        }
+    }
+    return n;
+}
+
+void search_index::posting_list::block::encode(std::size_t const * positions, std::size_t n)
+{
+    data.clear();
+    count = 0;
+    for (std::size_t i = 0; i < n; ++i)
+        append(positions[i]);
+}
+
+void search_index::posting_list::block::append(std::size_t pos)
+{
+    std::size_t delta = count == 0 ? pos : pos - last;
+    while (delta >= 0x80)
+    {
+        data.push_back(static_cast<std::uint8_t>(delta | 0x80));
+        delta >>= 7;
+    }
+    data.push_back(static_cast<std::uint8_t>(delta));
+
+    last = pos;
+    count++;
+}
+
+void search_index::posting_list::append(std::size_t pos)
+{
+    // An entry contains a trigram possibly more than once.
+    if (!_blocks.empty() && pos == _blocks.back().last)
+        return;
+
+    if (_blocks.empty() || _blocks.back().count == BLOCK_SIZE)
+        _blocks.emplace_back();
+    _blocks.back().append(pos);
+    count++;
+}
+
+std::vector<search_index::posting_list::block>::iterator search_index::posting_list::find_block(std::size_t pos)
+{
+    return std::lower_bound(_blocks.begin(), _blocks.end(), pos, [](block const & b, std::size_t p){ return b.last < p; });
+}
+
+void search_index::posting_list::insert(std::size_t pos)
+{
+    auto it = find_block(pos);
+    if (it == _blocks.end())
+    {
+        append(pos);
+        return;
+    }
+
+    std::array<std::size_t, BLOCK_SIZE + 1> positions;
+    std::size_t n = it->decode(positions.data());
+    std::size_t * const p = std::lower_bound(positions.data(), positions.data() + n, pos);
+    if (p != positions.data() + n && *p == pos)
+        return;
+    std::copy_backward(p, positions.data() + n, positions.data() + n + 1);
+    *p = pos;
+    n++;
+    count++;
+
+    // Full blocks are split in halves, so inserting next to each other does
+    // not split every time.
+    if (n > BLOCK_SIZE)
+    {
+        std::size_t const half = n / 2;
+        it->encode(positions.data(), half);
+        it = _blocks.emplace(std::next(it));
+        it->encode(positions.data() + half, n - half);
+    }
+    else
+    {
+        it->encode(positions.data(), n);
+    }
+}
+
+void search_index::posting_list::erase(std::size_t pos)
+{
+    auto it = find_block(pos);
+    if (it == _blocks.end())
+        return;
+
+    std::array<std::size_t, BLOCK_SIZE> positions;
+    std::size_t n = it->decode(positions.data());
+    std::size_t * const end = std::remove(positions.data(), positions.data() + n, pos);
+    if (end == positions.data() + n)
+        return;
+    n--;
+    count--;
+
+    if (n == 0)
+        _blocks.erase(it);
+    else
+        it->encode(positions.data(), n);
+}
+
+std::vector<std::size_t> search_index::posting_list::decode() const
+{
+    std::vector<std::size_t> result(count);
+    std::size_t n = 0;
+    for (block const & b : _blocks)
+        n += b.decode(result.data() + n);
+    return result;
+}
+
+// Entries are scanned in chunks of at least this size. Smaller chunks allow
+// for earlier cancellation.
+static std::size_t const MIN_CHUNK_SIZE = 2048;
+static std::size_t const MAX_CHUNKS = 64;
+
+search_index::search_index(bool use_trigrams)
+    : _waiting_modifications(0)
+    , _used_bytes(0)
+    , _in_order(true)
+    , _use_trigrams(use_trigrams)
+{
+}
+
+void search_index::assign(std::vector<queue_entry> const & entries, std::shared_ptr<string_interner const> tag_interner)
+{
+    _waiting_modifications++;
+    std::scoped_lock lock(_mutex);
+    _waiting_modifications--;
+
+    _buffer.clear();
+    _region_offsets.assign(1, 0);
+    _region_offsets.reserve(entries.size() + 1);
+    _region_positions.clear();
+    _region_positions.reserve(entries.size());
+    _entry_regions.assign(entries.size(), 0);
+    _entry_sizes.assign(entries.size(), 0);
+    _used_bytes = 0;
+    _in_order = true;
+    for (auto & c : _columns)
+        c = column();
+    _folded_paths.clear();
+    _folded_paths.reserve(entries.size());
+    _tag_interner = std::move(tag_interner);
+
+    for (std::size_t pos = 0; pos < entries.size(); ++pos)
+    {
+        folded_entry f = fold_entry(entries[pos]);
+
+        append_entry(pos, f.text);
+
+        for (std::size_t i = 0; i < QUEUE_TAG_COUNT; ++i)
+            _columns[i].ids.push_back(_columns[i].intern(f.tag_data[i], std::move(f.tags[i])));
+        _folded_paths.push_back(std::move(f.path));
+    }
+
+    rebuild_trigrams();
+}
+
+void search_index::update(unsigned int new_length, diff_type const & changed_positions, std::shared_ptr<string_interner const> tag_interner)
+{
+    // Folding does not need the lock. Changes are applied in order of their
+    // position and only the last change of a position counts, so the work
+    // depends on the number of changes and not on the length of the queue.
+    auto & changed = _folded_changes;
+    changed.clear();
+    for (auto const & p : changed_positions)
+    {
+        if (p.first < new_length)
+            changed.emplace_back(p.first, fold_entry(p.second));
+    }
+    auto const position_equal = [](auto const & a, auto const & b){ return a.first == b.first; };
+    std::stable_sort(changed.begin(), changed.end(), [](auto const & a, auto const & b){ return a.first < b.first; });
+    changed.erase(changed.begin(), std::unique(changed.rbegin(), changed.rend(), position_equal).base());
+
+    _waiting_modifications++;
+    std::scoped_lock lock(_mutex);
+    _waiting_modifications--;
+
+    std::size_t const old_length = size();
+
+    // The postings of the old entries are removed and the ones of the new
+    // entries added afterwards, only for the touched trigrams.
+    _trigram_changes.clear();
+    if (_use_trigrams)
+    {
+        for (std::size_t pos = new_length; pos < old_length; ++pos)
+            collect_trigrams(pos, false);
+        for (auto it = changed.begin(); it != changed.end() && it->first < old_length; ++it)
+            collect_trigrams(it->first, false);
+    }
+
+    // Unchanged entries stay where they are.
+    for (std::size_t pos = new_length; pos < old_length; ++pos)
+        remove_entry(pos);
+
+    _entry_regions.resize(new_length, 0);
+    _entry_sizes.resize(new_length, 0);
+
+    auto it = changed.begin();
+    for (; it != changed.end() && it->first < old_length; ++it)
+        replace_entry(it->first, it->second.text);
+    for (std::size_t pos = old_length; pos < new_length; ++pos)
+    {
+        if (it != changed.end() && it->first == pos)
+        {
+            append_entry(pos, it->second.text);
+            ++it;
+        }
+        else
+        {
+            append_entry(pos, std::string_view());
+        }
+    }
+
+    if (_buffer.size() - _used_bytes > 4096 + _used_bytes)
+        compact_buffer();
+
+    _folded_paths.resize(new_length);
+    for (auto & p : changed)
+        _folded_paths[p.first] = std::move(p.second.path);
+
+    // The data of tags of the former interner may be reused by the new one.
+    // It comes with a replaced queue, whose values are mostly unreferenced
+    // afterwards.
+    bool const interner_changed = tag_interner != _tag_interner;
+    if (interner_changed)
+    {
+        for (auto & c : _columns)
+            c.lookup.clear();
+        _tag_interner = std::move(tag_interner);
+    }
+
+    for (std::size_t i = 0; i < QUEUE_TAG_COUNT; ++i)
+    {
+        column & c = _columns[i];
+        c.ids.resize(new_length, 0);
+        for (auto & p : changed)
+            c.ids[p.first] = c.intern(p.second.tag_data[i], std::move(p.second.tags[i]));
+
+        if (interner_changed || c.values.size() > 64 + 2 * size())
+            c.compact();
+    }
+
+    if (_use_trigrams)
+    {
+        for (auto const & p : changed)
+            collect_trigrams(p.first, true);
+        update_postings();
+    }
+    changed.clear();
+}
+
+search_index::search_result search_index::find(search_query const & query, worker_pool * pool, std::function<bool()> const & cancelled) const
+{
+    std::scoped_lock lock(_mutex);
+
+    if (query.terms.size() == 1 && !query.terms.front().opt_field.has_value())
+        return find_plain(query.terms.front().folded_value, pool, cancelled);
+
+    std::vector<term_matcher> const matchers = make_matchers(query);
+
+    // Scanning for the longest term without a field is usually faster than
+    // checking every entry.
+    auto it = std::max_element(query.terms.begin(), query.terms.end(), [](search_term const & a, search_term const & b)
+    {
+        return (a.opt_field.has_value() ? 0 : a.folded_value.size() + 1) < (b.opt_field.has_value() ? 0 : b.folded_value.size() + 1);
+    });
+    if (it != query.terms.end() && !it->opt_field.has_value())
+    {
+        auto opt_candidates = find_plain(it->folded_value, pool, cancelled);
+        if (!opt_candidates.has_value())
+            return std::nullopt;
+
+        auto const & candidates = opt_candidates.value();
+        return collect_chunked(candidates.size(), pool, cancelled, [&](std::size_t begin, std::size_t end, std::vector<std::size_t> & result)
+        {
+            for (std::size_t i = begin; i < end; ++i)
+            {
+                if (matches(matchers, candidates[i]))
+                    result.push_back(candidates[i]);
+            }
+        });
+    }
+
+    return collect_chunked(size(), pool, cancelled, [&](std::size_t begin, std::size_t end, std::vector<std::size_t> & result)
+    {
+        for (std::size_t pos = begin; pos < end; ++pos)
+        {
+            if (matches(matchers, pos))
+                result.push_back(pos);
+        }
+    });
+}
+
+search_index::search_result search_index::narrow(search_query const & query, std::vector<std::size_t> const & positions, worker_pool * pool, std::function<bool()> const & cancelled) const
+{
+    std::scoped_lock lock(_mutex);
+
+    std::vector<term_matcher> const matchers = make_matchers(query);
+
+    return collect_chunked(positions.size(), pool, cancelled, [&](std::size_t begin, std::size_t end, std::vector<std::size_t> & result)
+    {
+        for (std::size_t i = begin; i < end; ++i)
+        {
+            std::size_t const pos = positions[i];
+            if (pos < size() && matches(matchers, pos))
+                result.push_back(pos);
+        }
+    });
+}
+
+search_index::search_result search_index::find_plain(std::string_view folded_term, worker_pool * pool, std::function<bool()> const & cancelled) const
+{
+    if (folded_term.empty())
+    {
+        std::vector<std::size_t> result(size());
+        for (std::size_t pos = 0; pos < result.size(); ++pos)
+            result[pos] = pos;
+        return result;
+    }
+
+    if (_use_trigrams && folded_term.size() >= 3)
+    {
+        std::vector<std::size_t> const candidates = trigram_candidates(folded_term);
+        return collect_chunked(candidates.size(), pool, cancelled, [&](std::size_t begin, std::size_t end, std::vector<std::size_t> & result)
+        {
+            for (std::size_t i = begin; i < end; ++i)
+            {
+                if (find_substring(entry(candidates[i]), folded_term) != std::string_view::npos)
+                    result.push_back(candidates[i]);
+            }
+        });
+    }
+
+    // Scan the whole range of regions at once and skip to the next region on
+    // a match.
+    auto opt_result = collect_chunked(_region_positions.size(), pool, cancelled, [&](std::size_t begin, std::size_t end, std::vector<std::size_t> & result)
+    {
+        std::string_view const range = std::string_view(_buffer).substr(0, _region_offsets[end]);
+        std::size_t offset = _region_offsets[begin];
+        while ((offset = find_substring(range, folded_term, offset)) != std::string_view::npos)
+        {
+            auto it = std::upper_bound(_region_offsets.begin(), _region_offsets.end(), offset);
+            std::size_t const region = std::distance(_region_offsets.begin(), it) - 1;
+            if (_region_positions[region] != NO_POSITION)
+                result.push_back(_region_positions[region]);
+            offset = _region_offsets[region + 1];
+        }
+    });
+
+    if (opt_result.has_value() && !_in_order)
+        std::sort(opt_result->begin(), opt_result->end());
+    return opt_result;
+}
+
+std::vector<search_index::term_matcher> search_index::make_matchers(search_query const & query) const
+{
+    std::vector<term_matcher> result;
+    result.reserve(query.terms.size());
+
+    for (auto const & t : query.terms)
+    {
+        term_matcher m { t.folded_value, nullptr, {}, t.opt_field == queue_field::PATH };
+        if (t.opt_field.has_value() && !m.on_path)
+        {
+            // The dictionary is usually much smaller than the queue.
+            column const & c = _columns[static_cast<std::size_t>(t.opt_field.value())];
+            m.opt_column = &c;
+            m.matching_ids.reserve(c.values.size());
+            for (auto const & v : c.values)
+                m.matching_ids.push_back(find_substring(v, t.folded_value) != std::string_view::npos);
+        }
+        result.push_back(std::move(m));
+    }
+    return result;
+}
+
+bool search_index::matches(std::vector<term_matcher> const & matchers, std::size_t pos) const
+{
+    return std::all_of(matchers.begin(), matchers.end(), [this, pos](term_matcher const & m)
+    {
+        if (m.opt_column != nullptr)
+        {
+            std::uint32_t const id = m.opt_column->ids[pos];
+            return id < m.matching_ids.size() && m.matching_ids[id] != 0;
+        }
+        else
+            return find_substring(text(pos, m.on_path), m.folded_value) != std::string_view::npos;
+    });
+}
+
+// Allowed edits for a fuzzy search term, short terms would match almost
+// anything otherwise.
+static unsigned int max_edits(std::size_t term_size)
+{
+    return term_size < 3 ? 0 : (term_size < 6 ? 1 : 2);
+}
+
+search_index::search_result search_index::find_fuzzy(search_query const & query, std::size_t max_results, worker_pool * pool, std::function<bool()> const & cancelled) const
+{
+    std::scoped_lock lock(_mutex);
+
+    struct fuzzy_term
+    {
+        std::string_view folded_value;
+        fuzzy_pattern pattern;
+        unsigned int max_edits;
+        // For a tag, the edits of every value in the dictionary, up to one
+        // more than allowed.
+        column const * opt_column;
+        std::vector<std::uint8_t> value_edits;
+        bool on_path;
+    };
+
+    std::vector<fuzzy_term> terms;
+    for (auto const & t : query.terms)
+    {
+        if (t.folded_value.empty())
+            continue;
+
+        fuzzy_term ft { t.folded_value, fuzzy_pattern(t.folded_value), max_edits(t.folded_value.size()), nullptr, {}, t.opt_field == queue_field::PATH };
+        if (t.opt_field.has_value() && !ft.on_path)
+        {
+            column const & c = _columns[static_cast<std::size_t>(t.opt_field.value())];
+            ft.opt_column = &c;
+            ft.value_edits.reserve(c.values.size());
+            for (auto const & v : c.values)
+                ft.value_edits.push_back(std::min(ft.pattern.distance(v), ft.max_edits + 1));
+        }
+        terms.push_back(std::move(ft));
+    }
+
+    if (terms.empty() || max_results == 0)
+        return std::vector<std::size_t>();
+
+    // Fields only cost a lookup and long terms reject the most entries, both
+    // allow to stop early.
+    std::stable_sort(terms.begin(), terms.end(), [](fuzzy_term const & a, fuzzy_term const & b)
+    {
+        return (a.opt_column != nullptr) > (b.opt_column != nullptr)
+            || ((a.opt_column != nullptr) == (b.opt_column != nullptr) && a.pattern.size() > b.pattern.size());
+    });
+
+    // Each chunk keeps its best entries in a heap with the worst on top.
+    typedef std::pair<unsigned int, std::size_t> scored_position;
+    std::vector<std::vector<scored_position>> heaps(chunk_count(size()));
+
+    bool const completed = run_chunked(size(), pool, cancelled, [&](std::size_t chunk, std::size_t begin, std::size_t end)
+    {
+        auto & heap = heaps[chunk];
+        for (std::size_t pos = begin; pos < end; ++pos)
+        {
+            // Positions increase, so an entry has to be strictly better than
+            // the worst one kept.
+            bool const full = heap.size() == max_results;
+            unsigned int const bound = full ? heap.front().first - 1 : UINT_MAX;
+
+            unsigned int total = 0;
+            bool rejected = full && heap.front().first == 0;
+            for (auto it = terms.begin(); !rejected && it != terms.end(); ++it)
+            {
+                unsigned int edits;
+                if (it->opt_column != nullptr)
+                {
+                    std::uint32_t const id = it->opt_column->ids[pos];
+                    edits = id < it->value_edits.size() ? it->value_edits[id] : it->max_edits + 1;
+                }
+                else if (total == bound)
+                {
+                    // No edits are left, an exact match is much cheaper.
+                    edits = find_substring(text(pos, it->on_path), it->folded_value) != std::string_view::npos ? 0 : it->max_edits + 1;
+                }
+                else
+                {
+                    edits = it->pattern.distance(text(pos, it->on_path));
+                }
+
+                total += edits;
+                rejected = edits > it->max_edits || total > bound;
+            }
+
+            if (rejected)
+                continue;
+
+            if (full)
+            {
+                std::pop_heap(heap.begin(), heap.end());
+                heap.pop_back();
+            }
+            heap.emplace_back(total, pos);
+            std::push_heap(heap.begin(), heap.end());
+        }
+    });
+
+    if (!completed)
+        return std::nullopt;
+
+    std::vector<scored_position> best;
+    for (auto const & heap : heaps)
+        best.insert(best.end(), heap.begin(), heap.end());
+    std::sort(best.begin(), best.end());
+    if (best.size() > max_results)
+        best.resize(max_results);
+
+    std::vector<std::size_t> result;
+    result.reserve(best.size());
+    for (auto const & sp : best)
+        result.push_back(sp.second);
+    return result;
+}
+
+std::size_t search_index::chunk_count(std::size_t n)
+{
+    return std::clamp<std::size_t>(n / MIN_CHUNK_SIZE, 1, MAX_CHUNKS);
+}
+
+bool search_index::run_chunked( std::size_t n
+                              , worker_pool * pool
+                              , std::function<bool()> const & cancelled
+                              , std::function<void(std::size_t, std::size_t, std::size_t)> const & process
+                              ) const
+{
+    std::size_t const num_chunks = chunk_count(n);
+    std::atomic<bool> aborted(false);
+
+    std::function<void(std::size_t)> const run_chunk = [&](std::size_t chunk)
+    {
+        if (aborted || _waiting_modifications != 0 || (cancelled && cancelled()))
+        {
+            aborted = true;
+            return;
+        }
+        process(chunk, n * chunk / num_chunks, n * (chunk + 1) / num_chunks);
+    };
+
+    if (pool != nullptr && num_chunks > 1)
+    {
+        pool->run(num_chunks, run_chunk);
+    }
+    else
+    {
+        for (std::size_t chunk = 0; chunk < num_chunks; ++chunk)
+            run_chunk(chunk);
+    }
+
+    return !aborted;
+}
+
+search_index::search_result search_index::collect_chunked( std::size_t n
+                                                         , worker_pool * pool
+                                                         , std::function<bool()> const & cancelled
+                                                         , std::function<void(std::size_t, std::size_t, std::vector<std::size_t> &)> const & collect
+                                                         ) const
+{
+    std::size_t const num_chunks = chunk_count(n);
+    std::vector<std::vector<std::size_t>> partial_results(num_chunks);
+
+    bool const completed = run_chunked(n, pool, cancelled, [&](std::size_t chunk, std::size_t begin, std::size_t end)
+    {
+        collect(begin, end, partial_results[chunk]);
+    });
+
+    if (!completed)
+        return std::nullopt;
+
+    // Chunks are in order, so are their results.
+    std::vector<std::size_t> result = std::move(partial_results.front());
+    for (std::size_t chunk = 1; chunk < num_chunks; ++chunk)
+        result.insert(result.end(), partial_results[chunk].begin(), partial_results[chunk].end());
+    return result;
+}
+
+std::size_t search_index::size() const
+{
+    return _entry_sizes.size();
+}
+
+std::string search_index::fold(std::string_view s)
+{
+    // For ASCII, normalization changes nothing and case folding is plain
+    // lowercasing.
+    if (is_ascii(s))
+        return ascii_to_lower(s);
+
+    return fold_unicode(s);
+}
+
+std::string search_index::fold_unicode(std::string_view s)
+{
+    icu::UnicodeString const us = icu::UnicodeString::fromUTF8(icu::StringPiece(s.data(), s.size()));
+
+    UErrorCode error_code = U_ZERO_ERROR;
+    icu::Normalizer2 const * normalizer = icu::Normalizer2::getNFKCCasefoldInstance(error_code);
+
+    std::string result;
+    if (U_SUCCESS(error_code))
+    {
+        icu::UnicodeString const normalized = normalizer->normalize(us, error_code);
+        if (U_SUCCESS(error_code))
+            return normalized.toUTF8String(result);
+    }
+
+    // fall back to simple case folding
+    return icu::UnicodeString(us).foldCase().toUTF8String(result);
+}
+
+search_index::folded_entry search_index::fold_entry(queue_entry const & e)
+{
+    folded_entry result;
+    for (std::size_t i = 0; i < QUEUE_TAG_COUNT; ++i)
+    {
+        result.tags[i] = fold(e.tags[i]);
+        result.tag_data[i] = e.tags[i].data();
+
+        // Terms without a field match any tag but the path. Terms can not
+        // contain the separator, so they never span two tags.
+        if (!result.tags[i].empty())
+        {
+            if (!result.text.empty())
+                result.text.push_back('\x1f');
+            result.text += result.tags[i];
+        }
+    }
+    result.path = fold(e.path);
+    return result;
+}
+
+std::uint32_t search_index::column::intern(char const * tag, std::string && folded_value)
+{
+    auto it = lookup.find(tag);
+    if (it != lookup.end())
+        return it->second;
+
+    std::uint32_t const id = values.size();
+    values.push_back(std::move(folded_value));
+    tags.push_back(tag);
+    lookup.emplace(tag, id);
+    return id;
+}
+
+void search_index::column::compact()
+{
+    std::uint32_t const NO_ID = UINT32_MAX;
+
+    column result;
+    result.ids.reserve(ids.size());
+    std::vector<std::uint32_t> new_ids(values.size(), NO_ID);
+    for (std::uint32_t id : ids)
+    {
+        if (new_ids[id] == NO_ID)
+        {
+            new_ids[id] = result.values.size();
+            result.values.push_back(std::move(values[id]));
+            result.tags.push_back(tags[id]);
+
+            // Values that were dropped from the lookup stay out of it.
+            auto it = lookup.find(tags[id]);
+            if (it != lookup.end() && it->second == id)
+                result.lookup.emplace(tags[id], new_ids[id]);
+        }
+        result.ids.push_back(new_ids[id]);
+    }
+    *this = std::move(result);
+}
+
+std::string_view search_index::entry(std::size_t pos) const
+{
+    return std::string_view(_buffer).substr(_region_offsets[_entry_regions[pos]], _entry_sizes[pos]);
+}
+
+std::string_view search_index::text(std::size_t pos, bool on_path) const
+{
+    return on_path ? std::string_view(_folded_paths[pos]) : entry(pos);
+}
+
+void search_index::append_entry(std::size_t pos, std::string_view text)
+{
+    // Behind a removed entry the order is unknown.
+    if (!_region_positions.empty() && (_region_positions.back() == NO_POSITION || _region_positions.back() > pos))
+        _in_order = false;
+
+    _entry_regions[pos] = _region_positions.size();
+    _entry_sizes[pos] = text.size();
+    _region_positions.push_back(pos);
+
+    _buffer += text;
+    _buffer.push_back('\0');
+    _region_offsets.push_back(_buffer.size());
+    _used_bytes += text.size() + 1;
+}
+
+void search_index::replace_entry(std::size_t pos, std::string_view text)
+{
+    std::size_t const region = _entry_regions[pos];
+    std::size_t const begin = _region_offsets[region];
+    std::size_t const capacity = _region_offsets[region + 1] - begin;
+
+    if (text.size() < capacity)
+    {
+        _buffer.replace(begin, text.size(), text);
+        std::fill(_buffer.begin() + begin + text.size(), _buffer.begin() + begin + capacity, '\0');
+        _used_bytes = _used_bytes - _entry_sizes[pos] + text.size();
+        _entry_sizes[pos] = text.size();
+    }
+    else
+    {
+        remove_entry(pos);
+        append_entry(pos, text);
+    }
+}
+
+void search_index::remove_entry(std::size_t pos)
+{
+    std::size_t const region = _entry_regions[pos];
+    std::fill(_buffer.begin() + _region_offsets[region], _buffer.begin() + _region_offsets[region + 1], '\0');
+    _region_positions[region] = NO_POSITION;
+    _used_bytes -= _entry_sizes[pos] + 1;
+}
+
+void search_index::compact_buffer()
+{
+    std::string buffer;
+    buffer.swap(_buffer);
+    _buffer.reserve(_used_bytes);
+
+    std::vector<std::uint32_t> const entry_regions = std::move(_entry_regions);
+    std::vector<std::size_t> const region_offsets = std::move(_region_offsets);
+    _entry_regions.assign(entry_regions.size(), 0);
+    _region_offsets.assign(1, 0);
+    _region_offsets.reserve(entry_regions.size() + 1);
+    _region_positions.clear();
+    _region_positions.reserve(entry_regions.size());
+    _used_bytes = 0;
+    _in_order = true;
+
+    for (std::size_t pos = 0; pos < entry_regions.size(); ++pos)
+        append_entry(pos, std::string_view(buffer).substr(region_offsets[entry_regions[pos]], _entry_sizes[pos]));
+}
+
+void search_index::rebuild_trigrams()
+{
+    _postings.clear();
+
+    if (!_use_trigrams)
+        return;
+
+    for (std::size_t pos = 0; pos < size(); ++pos)
+        add_trigrams(pos);
+}
+
+void search_index::add_trigrams(std::size_t pos)
+{
+    std::string_view const e = entry(pos);
+    for (std::size_t i = 0; i + 3 <= e.size(); ++i)
+        _postings[trigram_at(e, i)].append(pos);
+}
+
+void search_index::collect_trigrams(std::size_t pos, bool added)
+{
+    std::string_view const e = entry(pos);
+    for (std::size_t i = 0; i + 3 <= e.size(); ++i)
+        _trigram_changes.push_back(trigram_change{ trigram_at(e, i), static_cast<std::uint32_t>(pos), added });
+}
+
+void search_index::update_postings()
+{
+    auto & tc = _trigram_changes;
+    auto const key = [](trigram_change const & c){ return std::make_tuple(c.trigram, c.pos, c.added); };
+    std::sort(tc.begin(), tc.end(), [&key](auto const & a, auto const & b){ return key(a) < key(b); });
+    tc.erase(std::unique(tc.begin(), tc.end(), [&key](auto const & a, auto const & b){ return key(a) == key(b); }), tc.end());
+
+    for (auto it = tc.begin(); it != tc.end(); ++it)
+    {
+        // An entry that still contains the trigram keeps its posting.
+        auto const next = std::next(it);
+        if (next != tc.end() && next->trigram == it->trigram && next->pos == it->pos)
+        {
+            it = next;
+            continue;
+        }
+
+        posting_list & l = _postings[it->trigram];
+        if (it->added)
+        {
+            l.insert(it->pos);
+        }
+        else
+        {
+            l.erase(it->pos);
+            if (l.count == 0)
+                _postings.erase(it->trigram);
+        }
+    }
+    tc.clear();
+}
+
+std::vector<std::size_t> search_index::trigram_candidates(std::string_view folded_term) const
+{
+    std::vector<posting_list const *> lists;
+    bool missing = false;
+    for (std::size_t i = 0; i + 3 <= folded_term.size(); ++i)
+    {
+        auto it = _postings.find(trigram_at(folded_term, i));
+        if (it == _postings.end())
+        {
+            missing = true;
+            break;
+        }
+        lists.push_back(&it->second);
+    }
+
+    std::vector<std::size_t> result;
+    if (!missing)
+    {
+        // Start with the shortest list to keep intermediate results small.
+        std::sort(lists.begin(), lists.end(), [](auto a, auto b){ return std::make_pair(a->count, a) < std::make_pair(b->count, b); });
+        lists.erase(std::unique(lists.begin(), lists.end()), lists.end());
+
+        result = lists.front()->decode();
+        for (auto it = std::next(lists.begin()); it != lists.end() && !result.empty(); ++it)
+        {
+            std::vector<std::size_t> const positions = (*it)->decode();
+            std::vector<std::size_t> intersection;
+            std::set_intersection(result.begin(), result.end(), positions.begin(), positions.end(), std::back_inserter(intersection));
+            result = std::move(intersection);
+        }
+    }
+    return result;
+}
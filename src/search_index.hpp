@@ -0,0 +1,256 @@
+// SPDX-FileCopyrightText: Moritz Bruder <muesli4 at gmail dot com>
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "queue_entry.hpp"
+#include "search_query.hpp"
+#include "string_interner.hpp"
+#include "worker_pool.hpp"
+
+// Normalized and case-folded copies of the queue entries, kept in one
+// contiguous UTF-8 buffer. Each entry consists of all its tags except the path.
+// Searching is then a plain substring scan that does not allocate per entry.
+// Changed entries are rewritten in place or appended, so an update costs time
+// proportional to the changes until the buffer is compacted.
+//
+// For queries on a specific tag, every tag is additionally stored as a column
+// of ids into a dictionary of its distinct values, keyed on the interned tags.
+// A term is then matched once against each distinct value instead of against
+// every entry. Paths are unique, they are kept folded for each entry.
+//
+// Optionally, an inverted index maps each trigram (three bytes of folded
+// UTF-8) to the entries that contain it. For search terms of at least three
+// bytes, only entries that contain all of its trigrams are scanned. Updates
+// only rewrite the posting lists of the trigrams of changed entries.
+//
+// Searches may run on another thread than modifications. They are split into
+// chunks, which are distributed on a worker pool if one is given, and return
+// nothing if they are cancelled or a modification is waiting.
+struct search_index
+{
+    typedef std::vector<std::pair<unsigned int, queue_entry>> diff_type;
+
+    search_index(bool use_trigrams = false);
+
+    // The tags of the entries are interned by the given interner, which is
+    // kept alive. Tags of another interner than the one of the previous call
+    // are not mixed up with the former ones.
+    void assign(std::vector<queue_entry> const & entries, std::shared_ptr<string_interner const> tag_interner);
+
+    // Resize to the new length and replace the changed entries. Only those
+    // have to be folded again.
+    void update(unsigned int new_length, diff_type const & changed_positions, std::shared_ptr<string_interner const> tag_interner);
+
+    typedef std::optional<std::vector<std::size_t>> search_result;
+
+    // Positions of all entries that match the query, in ascending order.
+    search_result find(search_query const & query, worker_pool * pool, std::function<bool()> const & cancelled) const;
+
+    // Keep only the positions whose entries match the query. Costs time
+    // proportional to the number of positions.
+    search_result narrow(search_query const & query, std::vector<std::size_t> const & positions, worker_pool * pool, std::function<bool()> const & cancelled) const;
+
+    // Positions of at most max_results entries that match the query with a
+    // few typos, ranked by the total number of edits. Each term may differ by
+    // up to two edits, depending on its length. Ties keep the queue order.
+    search_result find_fuzzy(search_query const & query, std::size_t max_results, worker_pool * pool, std::function<bool()> const & cancelled) const;
+
+    // Only safe on the thread that modifies the index.
+    std::size_t size() const;
+
+    // NFKC with case folding, the same is applied to entries and search terms.
+    static std::string fold(std::string_view s);
+
+    // Same as fold, but without the fast path for ASCII.
+    static std::string fold_unicode(std::string_view s);
+
+    private:
+
+    // Sorted positions in blocks, each delta and varint encoded. A change
+    // only decodes and encodes the block it falls into.
+    struct posting_list
+    {
+        // The position must not be smaller than all others.
+        void append(std::size_t pos);
+
+        void insert(std::size_t pos);
+        void erase(std::size_t pos);
+
+        std::vector<std::size_t> decode() const;
+
+        std::size_t count = 0;
+
+        private:
+
+        static constexpr std::size_t BLOCK_SIZE = 128;
+
+        struct block
+        {
+            // Returns the number of positions.
+            std::size_t decode(std::size_t * positions) const;
+            void encode(std::size_t const * positions, std::size_t n);
+            void append(std::size_t pos);
+
+            std::vector<std::uint8_t> data;
+            std::size_t count = 0;
+            std::size_t last = 0;
+        };
+
+        // The first block whose last position is not smaller.
+        std::vector<block>::iterator find_block(std::size_t pos);
+
+        std::vector<block> _blocks;
+    };
+
+    // Folded values of one tag. Interned tags are equal if their data is, so
+    // the lookup does not hash their contents.
+    struct column
+    {
+        // Returns the id of the tag and adds its folded value if it is new.
+        std::uint32_t intern(char const * tag, std::string && folded_value);
+
+        // Drop values that are not referenced anymore.
+        void compact();
+
+        // for each position
+        std::vector<std::uint32_t> ids;
+
+        // the folded value and the interned tag of each id
+        std::vector<std::string> values;
+        std::vector<char const *> tags;
+        std::unordered_map<char const *, std::uint32_t> lookup;
+    };
+
+    struct folded_entry
+    {
+        std::string text;
+        std::array<std::string, QUEUE_TAG_COUNT> tags;
+        std::array<char const *, QUEUE_TAG_COUNT> tag_data;
+        std::string path;
+    };
+
+    // A search term prepared for matching single entries.
+    struct term_matcher
+    {
+        std::string_view folded_value;
+        // For a tag, the matching state of every value in the dictionary.
+        column const * opt_column;
+        std::vector<char> matching_ids;
+        bool on_path;
+    };
+
+    static folded_entry fold_entry(queue_entry const & e);
+
+    std::string_view entry(std::size_t pos) const;
+
+    // The folded path or all tags of an entry.
+    std::string_view text(std::size_t pos, bool on_path) const;
+
+    // Lock has to be held.
+    void append_entry(std::size_t pos, std::string_view text);
+    void replace_entry(std::size_t pos, std::string_view text);
+    void remove_entry(std::size_t pos);
+    void compact_buffer();
+
+    // Lock has to be held.
+    search_result find_plain(std::string_view folded_term, worker_pool * pool, std::function<bool()> const & cancelled) const;
+    std::vector<term_matcher> make_matchers(search_query const & query) const;
+    bool matches(std::vector<term_matcher> const & matchers, std::size_t pos) const;
+
+    static std::size_t chunk_count(std::size_t n);
+
+    // Process the chunks of [0, n) with their number and range. Returns
+    // false if it was cancelled.
+    bool run_chunked( std::size_t n
+                    , worker_pool * pool
+                    , std::function<bool()> const & cancelled
+                    , std::function<void(std::size_t, std::size_t, std::size_t)> const & process
+                    ) const;
+
+    // Collect positions from the ranges of [0, n) in order.
+    search_result collect_chunked( std::size_t n
+                                 , worker_pool * pool
+                                 , std::function<bool()> const & cancelled
+                                 , std::function<void(std::size_t, std::size_t, std::vector<std::size_t> &)> const & collect
+                                 ) const;
+
+    void rebuild_trigrams();
+    void add_trigrams(std::size_t pos);
+
+    // A posting to remove or add with the next call of update_postings.
+    struct trigram_change
+    {
+        std::uint32_t trigram;
+        std::uint32_t pos;
+        bool added;
+    };
+
+    // Lock has to be held.
+    void collect_trigrams(std::size_t pos, bool added);
+    void update_postings();
+
+    // Candidates for a search term of at least three bytes.
+    std::vector<std::size_t> trigram_candidates(std::string_view folded_term) const;
+
+    // Held by searches and modifications. A modification announces itself
+    // first to have searches give up early.
+    mutable std::mutex _mutex;
+    std::atomic<unsigned int> _waiting_modifications;
+
+    // Entries in the order they were written, each in a region that ends with
+    // a null character. Unused bytes of a region are null characters as
+    // well, which never match a search term.
+    std::string _buffer;
+
+    // start of each region and the end of the buffer
+    std::vector<std::size_t> _region_offsets { 0 };
+
+    // the position of the entry in each region or NO_POSITION
+    std::vector<std::uint32_t> _region_positions;
+    static constexpr std::uint32_t NO_POSITION = UINT32_MAX;
+
+    // for each position
+    std::vector<std::uint32_t> _entry_regions;
+    std::vector<std::uint32_t> _entry_sizes;
+
+    // bytes of the buffer used by entries, including their separators
+    std::size_t _used_bytes;
+
+    // whether regions are ordered by position, then a scan finds positions in
+    // ascending order
+    bool _in_order;
+
+    std::array<column, QUEUE_TAG_COUNT> _columns;
+    std::vector<std::string> _folded_paths;
+
+    // Keeps the interned tags the columns are keyed on alive, so their data
+    // is not reused for other tags.
+    std::shared_ptr<string_interner const> _tag_interner;
+
+    bool _use_trigrams;
+    std::unordered_map<std::uint32_t, posting_list> _postings;
+
+    // Postings collected by an update, kept to reuse its capacity.
+    std::vector<trigram_change> _trigram_changes;
+
+    // Folded changes of an update, kept to reuse its capacity. Only touched by
+    // update, outside of the lock.
+    std::vector<std::pair<std::size_t, folded_entry>> _folded_changes;
+};
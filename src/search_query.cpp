@@ -0,0 +1,99 @@
+// SPDX-FileCopyrightText: Moritz Bruder <muesli4 at gmail dot com>
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include <algorithm>
+#include <cctype>
+
+#include "search_index.hpp"
+#include "search_query.hpp"
+
+bool search_term::operator==(search_term const & other) const
+{
+    return opt_field == other.opt_field && folded_value == other.folded_value;
+}
+
+// Words like the '-' between artist and title in the displayed queue. Tags
+// are searched separately, so these would never match.
+static bool is_punctuation(std::string_view word)
+{
+    return std::all_of(word.begin(), word.end(), [](char c)
+    {
+        auto const uc = static_cast<unsigned char>(c);
+        return uc < 0x80 && std::ispunct(uc);
+    });
+}
+
+search_query search_query::parse(std::string_view input)
+{
+    std::string const folded_input = search_index::fold(input);
+    std::string_view rest = folded_input;
+
+    search_query result;
+    while (!rest.empty())
+    {
+        std::size_t const end = std::min(rest.find(' '), rest.size());
+        std::string_view const word = rest.substr(0, end);
+        rest.remove_prefix(std::min(end + 1, rest.size()));
+
+        if (word.empty())
+            continue;
+
+        search_term term;
+        std::size_t const colon = word.find(':');
+        if (colon != std::string_view::npos)
+            term.opt_field = queue_field_from_name(word.substr(0, colon));
+
+        term.folded_value = term.opt_field.has_value() ? word.substr(colon + 1) : word;
+        if (!term.opt_field.has_value() && is_punctuation(term.folded_value))
+            continue;
+
+        result.terms.push_back(std::move(term));
+    }
+    return result;
+}
+
+bool search_query::narrows(search_query const & other) const
+{
+    // Each term of the other query has to be implied by one of this query.
+    return std::all_of(other.terms.begin(), other.terms.end(), [this](search_term const & o)
+    {
+        return std::any_of(terms.begin(), terms.end(), [&o](search_term const & t)
+        {
+            bool const same_field = o.opt_field == t.opt_field
+                                 || (!o.opt_field.has_value() && t.opt_field != queue_field::PATH);
+            return same_field && t.folded_value.find(o.folded_value) != std::string::npos;
+        });
+    });
+}
+
+bool search_query::operator==(search_query const & other) const
+{
+    return terms == other.terms;
+}
+
+bool search_query::operator!=(search_query const & other) const
+{
+    return !(*this == other);
+}
+
+std::optional<queue_field> queue_field_from_name(std::string_view name)
+{
+    static std::pair<std::string_view, queue_field> const names[] =
+        { { "artist", queue_field::ARTIST }
+        , { "albumartist", queue_field::ALBUM_ARTIST }
+        , { "album", queue_field::ALBUM }
+        , { "title", queue_field::TITLE }
+        , { "composer", queue_field::COMPOSER }
+        , { "genre", queue_field::GENRE }
+        , { "path", queue_field::PATH }
+        , { "file", queue_field::PATH }
+        };
+
+    for (auto const & p : names)
+    {
+        if (p.first == name)
+            return p.second;
+    }
+    return std::nullopt;
+}
@@ -0,0 +1,41 @@
+// SPDX-FileCopyrightText: Moritz Bruder <muesli4 at gmail dot com>
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#pragma once
+
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "queue_entry.hpp"
+
+// One part of a query, e.g., 'album:moon'. Without a field, any tag except the
+// path may contain the value.
+struct search_term
+{
+    std::optional<queue_field> opt_field;
+    std::string folded_value;
+
+    bool operator==(search_term const & other) const;
+};
+
+// Terms separated by spaces that all have to match.
+struct search_query
+{
+    std::vector<search_term> terms;
+
+    // Unknown field names are part of the value. Words without a field that
+    // consist only of punctuation are left out.
+    static search_query parse(std::string_view input);
+
+    // True if every entry that matches this query matches the other one as
+    // well. The result of the other query can then be narrowed.
+    bool narrows(search_query const & other) const;
+
+    bool operator==(search_query const & other) const;
+    bool operator!=(search_query const & other) const;
+};
+
+std::optional<queue_field> queue_field_from_name(std::string_view name);
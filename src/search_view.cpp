@@ -4,43 +4,199 @@
 
 #include <algorithm>
 
-#include <unicode/unistr.h>
+#include <libwtk-sdl2/box.hpp>
 
 #include "widget_util.hpp"
 #include "search_view.hpp"
 
-search_view::search_view(SDL_Renderer * r, vec size, std::string keys, std::vector<std::string> const & values, std::function<void(std::size_t)> activate_callback)
-    : search_view(r, std::make_shared<keypad>(size, keys, [=](auto str){ on_submit(str); })
-    , std::make_shared<list_view>(_filtered_values, 0, [=](auto idx){ activate_callback(this->_filtered_indices[idx]); })
+search_view::search_view( SDL_Renderer * r
+                        , vec size
+                        , std::string keys
+                        , std::vector<std::string> const & values
+                        , search_index const & index
+                        , player_model & model
+                        , search_config const & cfg
+                        , std::function<void(std::function<void()>)> post
+                        )
+    : search_view(r, std::make_shared<keypad>(size, keys, [=](auto str){ on_submit(str); }, [=](auto str){ on_search_term_changed(str); })
+    , std::make_shared<list_view>(_filtered_values, 0, [=](auto idx){ on_activate(idx); })
+    , std::make_shared<text_button>("Queue", [=](){ toggle_library_mode(); })
     , values
+    , index
+    , model
+    , cfg
+    , post
     )
 {
 }
 
-search_view::search_view(SDL_Renderer * r, std::shared_ptr<keypad> keypad, std::shared_ptr<list_view> list_view, std::vector<std::string> const & values)
-    : embedded_widget<notebook>(std::vector<widget_ptr>{ keypad, add_list_view_controls(r, list_view, ICONDIR "keyboard.png", [this](){ on_back(); }) })
+search_view::search_view(SDL_Renderer * r, std::shared_ptr<keypad> keypad, std::shared_ptr<list_view> list_view, std::shared_ptr<text_button> mode_button, std::vector<std::string> const & values, search_index const & index, player_model & model, search_config const & cfg, std::function<void(std::function<void()>)> post)
+    : embedded_widget<notebook>(std::vector<widget_ptr>{ vbox({ { false, mode_button }, { true, keypad } }, 5)
+                                                       , add_list_view_controls(r, list_view, ICONDIR "keyboard.png", [this](){ on_back(); })
+                                                       })
     , _keypad(keypad)
     , _list_view(list_view)
+    , _mode_button(mode_button)
+    , _model(model)
     , _values(values)
+    , _index(index)
+    , _library_mode(false)
+    , _request_id(0)
+    , _searching(false)
+    , _updating(false)
+    , _search_worker(index, cfg.fuzzy, [this, post](){ post([this](){ on_search_result(); }); })
+    , _library_search([&model](auto const & query, auto start, auto end){ return model.search_library(query, start, end); }, cfg.library_limit, [this, post](){ post([this](){ on_library_result(); }); })
 {
 }
 
 void search_view::on_submit(std::string search_term)
 {
-    // TODO check if changed
-    _filtered_indices.clear();
+    // The result is usually up to date already.
+    if (!_library_mode && _result_stack.empty() && !_searching)
+        on_search_term_changed(search_term);
+    _embedded_widget.set_page(1);
+}
+
+void search_view::on_search_term_changed(std::string search_term)
+{
+    search_query query = search_query::parse(search_term);
+
+    if (_library_mode)
+    {
+        // Pages of the previous query may still arrive, they are dropped.
+        _request_id++;
+        _searching = true;
+        _filtered_values.clear();
+        _library_paths.clear();
+        _list_view->set_position(0);
+        _keypad->set_match_count(std::nullopt);
+        _library_search.request(_request_id, std::move(query));
+        return;
+    }
+
+    while (!_result_stack.empty() && !query.narrows(_result_stack.back().query))
+    {
+        _result_stack.pop_back();
+    }
+
+    // Any request in flight is outdated.
+    _request_id++;
+    _updating = false;
+
+    if (!_result_stack.empty() && _result_stack.back().query == query)
+    {
+        _searching = false;
+        show_result();
+    }
+    else
+    {
+        _searching = true;
+        _search_worker.request(search_request
+            { _request_id
+            , std::move(query)
+            , _result_stack.empty() ? nullptr : _result_stack.back().positions
+            , nullptr
+            });
+    }
+}
+
+void search_view::on_search_result()
+{
+    auto opt_result = _search_worker.take_result();
+    if (!opt_result.has_value() || opt_result->id != _request_id)
+        return;
+
+    _result_stack.push_back(std::move(opt_result.value()));
+    _searching = false;
+    show_result(_updating);
+    _updating = false;
+}
+
+void search_view::on_library_result()
+{
+    auto opt_result = _library_search.take_result();
+    if (!_library_mode || !opt_result.has_value() || opt_result->id != _request_id)
+        return;
+
+    bool const first = _filtered_values.empty();
+    for (library_song & song : opt_result->songs)
+    {
+        _filtered_values.push_back(std::move(song.display));
+        _library_paths.push_back(std::move(song.path));
+    }
+
+    // Keep the scroll position while further pages arrive.
+    if (first)
+        _list_view->set_position(0);
+
+    _searching = !opt_result->complete;
+    _keypad->set_match_count(_filtered_values.size());
+}
+
+void search_view::on_activate(std::size_t index)
+{
+    if (_library_mode)
+        _model.add_and_play(_library_paths[index]);
+    else
+        _model.play_position(_filtered_indices[index]);
+}
+
+void search_view::toggle_library_mode()
+{
+    _library_mode = !_library_mode;
+    _mode_button->set_label(_library_mode ? "Library" : "Queue");
+
+    _result_stack.clear();
     _filtered_values.clear();
+    _filtered_indices.clear();
+    _library_paths.clear();
+    on_search_term_changed(std::string(_keypad->get_input()));
+}
+
+void search_view::show_result(bool keep_position)
+{
+    // Ranked entries are shown in their order instead of an empty list.
+    search_result const & result = _result_stack.back();
+    std::vector<std::size_t> const & positions = result.positions->empty() && result.ranked_positions ? *result.ranked_positions : *result.positions;
+    std::size_t const old_size = _filtered_indices.size();
 
-    for (std::size_t pos = 0; pos < _values.get().size(); pos++)
+    // The list view needs its own strings. Those already shown are moved
+    // over, so narrowing a search does not copy any. Both lists have to be
+    // in ascending order for that, ranked ones are not.
+    std::vector<std::string> values;
+    values.reserve(positions.size());
+    bool const reuse = std::is_sorted(positions.begin(), positions.end())
+                    && std::is_sorted(_filtered_indices.begin(), _filtered_indices.end());
+    std::size_t old_index = 0;
+    for (std::size_t pos : positions)
     {
-        auto const & s = _values.get()[pos];
-        if (icu::UnicodeString::fromUTF8(s).toLower().indexOf(icu::UnicodeString::fromUTF8(search_term)) != -1)
+        std::string const & value = _values.get()[pos];
+        if (reuse)
         {
-            _filtered_indices.push_back(pos);
-            _filtered_values.push_back(s);
+            while (old_index < _filtered_indices.size() && _filtered_indices[old_index] < pos)
+                old_index++;
+        }
+
+        if (reuse && old_index < _filtered_indices.size() && _filtered_indices[old_index] == pos)
+        {
+            values.push_back(std::move(_filtered_values[old_index]));
+            // The entry at the position may have changed with the queue.
+            if (values.back() != value)
+                values.back() = value;
+        }
+        else
+        {
+            values.push_back(value);
         }
     }
-    _embedded_widget.set_page(1);
+
+    _filtered_indices = positions;
+    _filtered_values = std::move(values);
+
+    // The position has to stay within the list.
+    if (!keep_position || _filtered_indices.size() < old_size)
+        _list_view->set_position(0);
+    _keypad->set_match_count(_filtered_indices.size());
 }
 
 void search_view::on_back()
@@ -49,11 +205,54 @@ void search_view::on_back()
 }
 
 
-void search_view::on_playlist_changed()
+void search_view::on_playlist_changed(std::vector<std::size_t> const & changed_positions)
 {
-    // TODO safe search term in optional and do the search again if there has been an active search before
-    _list_view->set_position(0);
-    on_back();
+    // Adding songs from the library changes the queue, stay on the result.
+    if (_library_mode)
+    {
+        _result_stack.clear();
+        return;
+    }
+
+    if (_result_stack.empty() && !_searching)
+        return;
+
+    // A search in flight may have used the old queue and ranked entries may
+    // have been pushed out by any entry, search again.
+    if (_searching || _result_stack.back().ranked_positions)
+    {
+        _result_stack.clear();
+        on_search_term_changed(std::string(_keypad->get_input()));
+        return;
+    }
+
+    // Only the current result is updated, results below it are dropped.
+    search_result current = std::move(_result_stack.back());
+    _result_stack.clear();
+
+    std::size_t const new_length = _values.get().size();
+
+    auto changed = std::make_shared<std::vector<std::size_t>>();
+    for (std::size_t pos : changed_positions)
+    {
+        if (pos < new_length)
+            changed->push_back(pos);
+    }
+    std::sort(changed->begin(), changed->end());
+    changed->erase(std::unique(changed->begin(), changed->end()), changed->end());
+
+    // Unchanged entries that matched before still match.
+    auto kept = std::make_shared<std::vector<std::size_t>>();
+    for (std::size_t pos : *current.positions)
+    {
+        if (pos < new_length && !std::binary_search(changed->begin(), changed->end(), pos))
+            kept->push_back(pos);
+    }
+
+    _request_id++;
+    _searching = true;
+    _updating = true;
+    _search_worker.request(search_request{ _request_id, std::move(current.query), std::move(changed), std::move(kept) });
 }
 
 void search_view::set_position(std::size_t position)
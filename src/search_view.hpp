@@ -9,30 +9,77 @@
 #include <libwtk-sdl2/embedded_widget.hpp>
 #include <libwtk-sdl2/notebook.hpp>
 #include <libwtk-sdl2/list_view.hpp>
+#include <libwtk-sdl2/text_button.hpp>
 
 #include "keypad.hpp"
+#include "library_search.hpp"
+#include "player_model.hpp"
+#include "program_config.hpp"
+#include "search_index.hpp"
+#include "search_worker.hpp"
 
 struct search_view : embedded_widget<notebook>
 {
-    search_view(SDL_Renderer * r, vec size, std::string keys, std::vector<std::string> const & values, std::function<void(std::size_t)> activate_callback);
+    // The index has to match the values. Searches run in the background, post
+    // has to run the given function on the thread of the view. In library
+    // mode the database is searched with the model instead.
+    search_view( SDL_Renderer * r
+               , vec size
+               , std::string keys
+               , std::vector<std::string> const & values
+               , search_index const & index
+               , player_model & model
+               , search_config const & cfg
+               , std::function<void(std::function<void()>)> post
+               );
 
-    void on_playlist_changed();
+    // Re-evaluates the current search only for the changed positions.
+    void on_playlist_changed(std::vector<std::size_t> const & changed_positions);
     void set_position(std::size_t position);
     void set_filtered_highlight_position(std::size_t position);
     void set_selected_position(std::size_t position);
 
     private:
 
-    search_view(SDL_Renderer * r, std::shared_ptr<keypad> keypad, std::shared_ptr<list_view> list_view, std::vector<std::string> const & values);
+    search_view(SDL_Renderer * r, std::shared_ptr<keypad> keypad, std::shared_ptr<list_view> list_view, std::shared_ptr<text_button> mode_button, std::vector<std::string> const & values, search_index const & index, player_model & model, search_config const & cfg, std::function<void(std::function<void()>)> post);
 
     void on_submit(std::string search_term);
+    void on_search_term_changed(std::string search_term);
+    void on_search_result();
+    void on_library_result();
+    void on_activate(std::size_t index);
     void on_back();
+    void toggle_library_mode();
+
+    // Set the list to the result on top of the stack.
+    void show_result(bool keep_position = false);
 
     std::shared_ptr<keypad> _keypad;
     std::shared_ptr<list_view> _list_view;
+    std::shared_ptr<text_button> _mode_button;
+
+    player_model & _model;
 
     std::reference_wrapper<std::vector<std::string> const> _values;
+    std::reference_wrapper<search_index const> _index;
     std::vector<std::string> _filtered_values;
     std::vector<std::size_t> _filtered_indices;
 
+    // Search the database instead of the queue. The paths belong to the
+    // filtered values, the songs are only kept while they are shown.
+    bool _library_mode;
+    std::vector<std::string> _library_paths;
+
+    // Results of the queries typed so far, each one narrows the one below.
+    // Appending narrows the top, removing restores a previous one.
+    std::vector<search_result> _result_stack;
+
+    // Only the result of the latest request is used.
+    unsigned int _request_id;
+    bool _searching;
+    // the request updates the current result after the queue changed
+    bool _updating;
+
+    search_worker _search_worker;
+    library_search _library_search;
 };
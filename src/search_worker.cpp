@@ -0,0 +1,120 @@
+// SPDX-FileCopyrightText: Moritz Bruder <muesli4 at gmail dot com>
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include <algorithm>
+#include <iterator>
+
+#include "search_worker.hpp"
+
+// The search thread takes part in each search.
+static unsigned int pool_threads()
+{
+    unsigned int const cores = std::thread::hardware_concurrency();
+    return cores > 1 ? std::min(cores - 1, 3u) : 0;
+}
+
+// Ranked results are only useful up to a point.
+static std::size_t const MAX_FUZZY_RESULTS = 100;
+
+search_worker::search_worker(search_index const & index, bool fuzzy, std::function<void()> ready_callback)
+    : _index(index)
+    , _fuzzy(fuzzy)
+    , _ready_callback(ready_callback)
+    , _pool(pool_threads())
+    , _generation(0)
+    , _run(true)
+{
+    _thread = std::thread(&search_worker::run, this);
+}
+
+search_worker::~search_worker()
+{
+    stop();
+}
+
+void search_worker::request(search_request r)
+{
+    {
+        std::scoped_lock lock(_mutex);
+        _generation++;
+        _opt_result.reset();
+        _opt_request = std::move(r);
+    }
+    _cv.notify_one();
+}
+
+std::optional<search_result> search_worker::take_result()
+{
+    std::scoped_lock lock(_mutex);
+    std::optional<search_result> result;
+    result.swap(_opt_result);
+    return result;
+}
+
+void search_worker::stop()
+{
+    {
+        std::scoped_lock lock(_mutex);
+        _run = false;
+        _generation++;
+    }
+    _cv.notify_one();
+
+    if (_thread.joinable())
+        _thread.join();
+}
+
+void search_worker::run()
+{
+    std::unique_lock lock(_mutex);
+    while (true)
+    {
+        _cv.wait(lock, [this](){ return !_run || _opt_request.has_value(); });
+        if (!_run)
+            break;
+
+        search_request request = std::move(_opt_request.value());
+        _opt_request.reset();
+        unsigned int const generation = _generation;
+        lock.unlock();
+
+        auto const cancelled = [this, generation](){ return _generation != generation; };
+        auto opt_positions = request.base_positions
+                           ? _index.narrow(request.query, *request.base_positions, &_pool, cancelled)
+                           : _index.find(request.query, &_pool, cancelled);
+
+        if (opt_positions.has_value() && request.matched_positions && !request.matched_positions->empty())
+        {
+            std::vector<std::size_t> merged;
+            merged.reserve(opt_positions->size() + request.matched_positions->size());
+            std::merge( opt_positions->begin(), opt_positions->end()
+                      , request.matched_positions->begin(), request.matched_positions->end()
+                      , std::back_inserter(merged)
+                      );
+            opt_positions = std::move(merged);
+        }
+
+        // Narrowing an empty result would stay empty, so the whole index is
+        // searched.
+        decltype(opt_positions) opt_ranked_positions;
+        if (_fuzzy && opt_positions.has_value() && opt_positions->empty())
+            opt_ranked_positions = _index.find_fuzzy(request.query, MAX_FUZZY_RESULTS, &_pool, cancelled);
+
+        lock.lock();
+        if (opt_positions.has_value() && !cancelled())
+        {
+            _opt_result = search_result
+                { request.id
+                , std::move(request.query)
+                , std::make_shared<std::vector<std::size_t> const>(std::move(opt_positions.value()))
+                , opt_ranked_positions.has_value()
+                  ? std::make_shared<std::vector<std::size_t> const>(std::move(opt_ranked_positions.value()))
+                  : nullptr
+                };
+            lock.unlock();
+            _ready_callback();
+            lock.lock();
+        }
+    }
+}
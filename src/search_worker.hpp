@@ -0,0 +1,80 @@
+// SPDX-FileCopyrightText: Moritz Bruder <muesli4 at gmail dot com>
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "search_index.hpp"
+#include "search_query.hpp"
+#include "worker_pool.hpp"
+
+typedef std::shared_ptr<std::vector<std::size_t> const> shared_positions_ptr;
+
+struct search_request
+{
+    unsigned int id;
+    search_query query;
+    // narrow these if given instead of searching everything
+    shared_positions_ptr base_positions;
+    // known to match, merged into the result without checking them again
+    shared_positions_ptr matched_positions;
+};
+
+struct search_result
+{
+    unsigned int id;
+    search_query query;
+    shared_positions_ptr positions;
+    // If nothing matched exactly, the closest entries, best first.
+    shared_positions_ptr ranked_positions;
+};
+
+// Searches the index in the background, split across a pool of threads. Only
+// the latest request is of interest: a new request cancels the one in flight.
+struct search_worker
+{
+    // With fuzzy enabled, a query without any exact match is repeated to
+    // find entries with typos. The ready callback is called from the worker
+    // thread once a result can be taken.
+    search_worker(search_index const & index, bool fuzzy, std::function<void()> ready_callback);
+    ~search_worker();
+
+    void request(search_request r);
+
+    // Returns the result of the latest request if it is available.
+    std::optional<search_result> take_result();
+
+    void stop();
+
+    private:
+
+    void run();
+
+    search_index const & _index;
+    bool _fuzzy;
+    std::function<void()> _ready_callback;
+
+    worker_pool _pool;
+
+    // Increased with every request, a search is cancelled if it changes.
+    std::atomic<unsigned int> _generation;
+
+    std::mutex _mutex;
+    std::condition_variable _cv;
+    bool _run;
+    std::optional<search_request> _opt_request;
+    std::optional<search_result> _opt_result;
+
+    std::thread _thread;
+};
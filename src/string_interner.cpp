@@ -0,0 +1,58 @@
+// SPDX-FileCopyrightText: Moritz Bruder <muesli4 at gmail dot com>
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include <cstring>
+
+#include "string_interner.hpp"
+
+// Larger strings get a block of their own, so little space is wasted at the
+// end of a block.
+static std::size_t const BLOCK_SIZE = 64 * 1024;
+static std::size_t const MAX_SHARED_SIZE = BLOCK_SIZE / 16;
+
+string_interner::string_interner()
+    : _free(nullptr)
+    , _free_size(0)
+{
+}
+
+std::string_view string_interner::intern(std::string_view s)
+{
+    if (s.empty())
+        return std::string_view();
+
+    std::scoped_lock lock(_mutex);
+
+    auto it = _strings.find(s);
+    if (it != _strings.end())
+        return *it;
+
+    char * data = allocate(s.size());
+    std::memcpy(data, s.data(), s.size());
+
+    std::string_view const result(data, s.size());
+    _strings.insert(result);
+    return result;
+}
+
+char * string_interner::allocate(std::size_t n)
+{
+    if (n > MAX_SHARED_SIZE)
+    {
+        _blocks.push_back(std::make_unique<char[]>(n));
+        return _blocks.back().get();
+    }
+
+    if (n > _free_size)
+    {
+        _blocks.push_back(std::make_unique<char[]>(BLOCK_SIZE));
+        _free = _blocks.back().get();
+        _free_size = BLOCK_SIZE;
+    }
+
+    char * result = _free;
+    _free += n;
+    _free_size -= n;
+    return result;
+}
@@ -0,0 +1,37 @@
+// SPDX-FileCopyrightText: Moritz Bruder <muesli4 at gmail dot com>
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+// Stores each distinct string once in an arena of large blocks. Interned
+// strings are equal if and only if they have the same data pointer, and they
+// stay valid as long as the interner. Strings are never removed, an interner is
+// dropped as a whole once nothing refers to it anymore.
+//
+// Safe to use from multiple threads.
+struct string_interner
+{
+    string_interner();
+
+    // The empty string is interned as a view without data.
+    std::string_view intern(std::string_view s);
+
+    private:
+
+    char * allocate(std::size_t n);
+
+    std::mutex _mutex;
+    std::unordered_set<std::string_view> _strings;
+
+    std::vector<std::unique_ptr<char[]>> _blocks;
+    char * _free;
+    std::size_t _free_size;
+};
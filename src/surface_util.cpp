@@ -0,0 +1,252 @@
+// SPDX-FileCopyrightText: Moritz Bruder <muesli4 at gmail dot com>
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+#include <SDL2/SDL_image.h>
+
+#ifdef HAVE_LIBJPEG
+#include <csetjmp>
+#include <cstdio>
+#include <jpeglib.h>
+#endif
+
+#include "surface_util.hpp"
+
+void surface_deleter::operator()(SDL_Surface * s) const
+{
+    SDL_FreeSurface(s);
+}
+
+std::size_t surface_size_in_bytes(SDL_Surface const & s)
+{
+    return static_cast<std::size_t>(s.pitch) * s.h;
+}
+
+unique_surface_ptr load_surface_from_file(std::string const & filename)
+{
+    return unique_surface_ptr(IMG_Load(filename.c_str()));
+}
+
+unique_surface_ptr load_surface_from_memory(std::byte const * data, std::size_t size)
+{
+    SDL_RWops * rw = SDL_RWFromConstMem(data, static_cast<int>(size));
+    if (rw == nullptr)
+        return nullptr;
+
+    // frees the stream
+    return unique_surface_ptr(IMG_Load_RW(rw, 1));
+}
+
+
+// Averages all source pixels that fall into a target pixel, which gives a far
+// better result than nearest neighbor for larger factors.
+static unique_surface_ptr downscale_argb8888(SDL_Surface * src, int w, int h)
+{
+    unique_surface_ptr dst(SDL_CreateRGBSurfaceWithFormat(0, w, h, 32, SDL_PIXELFORMAT_ARGB8888));
+    if (!dst)
+        return nullptr;
+
+    std::vector<int> x_begin(w + 1);
+    for (int x = 0; x <= w; ++x)
+        x_begin[x] = static_cast<int>(static_cast<std::int64_t>(x) * src->w / w);
+
+    std::vector<std::uint64_t> sums(static_cast<std::size_t>(w) * 4);
+
+    SDL_LockSurface(src);
+    SDL_LockSurface(dst.get());
+    for (int y = 0; y < h; ++y)
+    {
+        int const sy_begin = static_cast<int>(static_cast<std::int64_t>(y) * src->h / h);
+        int const sy_end = std::max(sy_begin + 1, static_cast<int>(static_cast<std::int64_t>(y + 1) * src->h / h));
+
+        std::fill(sums.begin(), sums.end(), 0);
+        for (int sy = sy_begin; sy < sy_end; ++sy)
+        {
+            auto const * row = reinterpret_cast<std::uint32_t const *>(static_cast<std::uint8_t const *>(src->pixels) + sy * src->pitch);
+            for (int x = 0; x < w; ++x)
+            {
+                int const sx_end = std::max(x_begin[x] + 1, x_begin[x + 1]);
+                for (int sx = x_begin[x]; sx < sx_end; ++sx)
+                {
+                    std::uint32_t const p = row[sx];
+                    sums[x * 4] += (p >> 24) & 0xff;
+                    sums[x * 4 + 1] += (p >> 16) & 0xff;
+                    sums[x * 4 + 2] += (p >> 8) & 0xff;
+                    sums[x * 4 + 3] += p & 0xff;
+                }
+            }
+        }
+
+        auto * row = reinterpret_cast<std::uint32_t *>(static_cast<std::uint8_t *>(dst->pixels) + y * dst->pitch);
+        for (int x = 0; x < w; ++x)
+        {
+            std::uint64_t const n = static_cast<std::uint64_t>(sy_end - sy_begin) * std::max(1, x_begin[x + 1] - x_begin[x]);
+            row[x] = static_cast<std::uint32_t>(sums[x * 4] / n) << 24
+                   | static_cast<std::uint32_t>(sums[x * 4 + 1] / n) << 16
+                   | static_cast<std::uint32_t>(sums[x * 4 + 2] / n) << 8
+                   | static_cast<std::uint32_t>(sums[x * 4 + 3] / n);
+        }
+    }
+    SDL_UnlockSurface(dst.get());
+    SDL_UnlockSurface(src);
+
+    return dst;
+}
+
+// The factor to fit an image of the given size into the maximum size.
+static double fit_factor(int w, int h, vec max_size)
+{
+    double const factor_w = max_size.w > 0 ? static_cast<double>(max_size.w) / w : 1.0;
+    double const factor_h = max_size.h > 0 ? static_cast<double>(max_size.h) / h : 1.0;
+    return std::min(factor_w, factor_h);
+}
+
+unique_surface_ptr fit_surface(unique_surface_ptr s, vec max_size)
+{
+    if (!s)
+        return nullptr;
+
+    if (s->format->format != SDL_PIXELFORMAT_ARGB8888)
+    {
+        s.reset(SDL_ConvertSurfaceFormat(s.get(), SDL_PIXELFORMAT_ARGB8888, 0));
+        if (!s)
+            return nullptr;
+    }
+
+    double const factor = fit_factor(s->w, s->h, max_size);
+
+    if (factor >= 1.0)
+        return s;
+
+    int const w = std::max(1, static_cast<int>(s->w * factor));
+    int const h = std::max(1, static_cast<int>(s->h * factor));
+    return downscale_argb8888(s.get(), w, h);
+}
+
+#ifdef HAVE_LIBJPEG
+
+struct jpeg_error_handler
+{
+    jpeg_error_mgr mgr;
+    std::jmp_buf jump_buffer;
+};
+
+static void jpeg_error_exit(j_common_ptr cinfo)
+{
+    std::longjmp(reinterpret_cast<jpeg_error_handler *>(cinfo->err)->jump_buffer, 1);
+}
+
+// Unsupported images are handed to SDL_image, there is no need to report.
+static void jpeg_output_message(j_common_ptr)
+{
+}
+
+static bool is_jpeg(std::byte const * data, std::size_t size)
+{
+    return size >= 3
+        && data[0] == std::byte{0xff}
+        && data[1] == std::byte{0xd8}
+        && data[2] == std::byte{0xff};
+}
+
+// Decodes a JPEG image with the largest DCT scaling (1/2, 1/4 or 1/8) that
+// still covers the maximum size. Since errors are reported with longjmp, only
+// objects with trivial destructors may live in here. Returns nullptr on
+// failure.
+static SDL_Surface * load_jpeg_surface_scaled(std::byte const * data, std::size_t size, vec max_size)
+{
+    jpeg_decompress_struct cinfo;
+    jpeg_error_handler error_handler;
+    SDL_Surface * volatile surface = nullptr;
+
+    cinfo.err = jpeg_std_error(&error_handler.mgr);
+    error_handler.mgr.error_exit = jpeg_error_exit;
+    error_handler.mgr.output_message = jpeg_output_message;
+
+    if (setjmp(error_handler.jump_buffer))
+    {
+        jpeg_destroy_decompress(&cinfo);
+        SDL_FreeSurface(surface);
+        return nullptr;
+    }
+
+    jpeg_create_decompress(&cinfo);
+    jpeg_mem_src(&cinfo, const_cast<unsigned char *>(reinterpret_cast<unsigned char const *>(data)), size);
+    jpeg_read_header(&cinfo, TRUE);
+
+    double const factor = fit_factor(cinfo.image_width, cinfo.image_height, max_size);
+    unsigned int denom = 1;
+    while (denom < 8 && factor * denom * 2 <= 1.0)
+        denom *= 2;
+
+    cinfo.scale_num = 1;
+    cinfo.scale_denom = denom;
+    cinfo.out_color_space = JCS_RGB;
+    jpeg_start_decompress(&cinfo);
+
+    surface = SDL_CreateRGBSurfaceWithFormat(0, cinfo.output_width, cinfo.output_height, 32, SDL_PIXELFORMAT_ARGB8888);
+    if (surface == nullptr)
+    {
+        jpeg_destroy_decompress(&cinfo);
+        return nullptr;
+    }
+
+    // freed with the decompressor
+    JSAMPARRAY buffer = (*cinfo.mem->alloc_sarray)(reinterpret_cast<j_common_ptr>(&cinfo), JPOOL_IMAGE, cinfo.output_width * cinfo.output_components, 1);
+
+    while (cinfo.output_scanline < cinfo.output_height)
+    {
+        JDIMENSION const y = cinfo.output_scanline;
+        jpeg_read_scanlines(&cinfo, buffer, 1);
+
+        JSAMPLE const * src = buffer[0];
+        auto * dst = reinterpret_cast<std::uint32_t *>(static_cast<std::uint8_t *>(surface->pixels) + y * surface->pitch);
+        for (JDIMENSION x = 0; x < cinfo.output_width; ++x, src += 3)
+        {
+            dst[x] = 0xff000000u
+                   | static_cast<std::uint32_t>(src[0]) << 16
+                   | static_cast<std::uint32_t>(src[1]) << 8
+                   | static_cast<std::uint32_t>(src[2]);
+        }
+    }
+
+    jpeg_finish_decompress(&cinfo);
+    jpeg_destroy_decompress(&cinfo);
+    return surface;
+}
+
+#endif
+
+unique_surface_ptr load_fitted_surface_from_file(std::string const & filename, vec max_size)
+{
+#ifdef HAVE_LIBJPEG
+    std::ifstream file(filename, std::ios::binary);
+    if (!file)
+        return nullptr;
+
+    std::vector<char> data{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+    return load_fitted_surface_from_memory(reinterpret_cast<std::byte const *>(data.data()), data.size(), max_size);
+#else
+    return fit_surface(load_surface_from_file(filename), max_size);
+#endif
+}
+
+unique_surface_ptr load_fitted_surface_from_memory(std::byte const * data, std::size_t size, vec max_size)
+{
+#ifdef HAVE_LIBJPEG
+    if (is_jpeg(data, size))
+    {
+        unique_surface_ptr s(load_jpeg_surface_scaled(data, size, max_size));
+        if (s)
+            return fit_surface(std::move(s), max_size);
+    }
+#endif
+
+    return fit_surface(load_surface_from_memory(data, size), max_size);
+}
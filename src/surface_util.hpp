@@ -0,0 +1,42 @@
+// SPDX-FileCopyrightText: Moritz Bruder <muesli4 at gmail dot com>
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#ifndef SURFACE_UTIL_HPP
+#define SURFACE_UTIL_HPP
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+#include <SDL2/SDL.h>
+#include <libwtk-sdl2/geometry.hpp>
+
+struct surface_deleter
+{
+    void operator()(SDL_Surface * s) const;
+};
+
+typedef std::unique_ptr<SDL_Surface, surface_deleter> unique_surface_ptr;
+typedef std::shared_ptr<SDL_Surface> shared_surface_ptr;
+
+// memory used by the pixels
+std::size_t surface_size_in_bytes(SDL_Surface const & s);
+
+// Decoding does not require a renderer and may therefore happen on any thread.
+// Both return nullptr on failure.
+unique_surface_ptr load_surface_from_file(std::string const & filename);
+unique_surface_ptr load_surface_from_memory(std::byte const * data, std::size_t size);
+
+// Scale the surface down to fit into the given size while keeping its aspect
+// ratio. The result is always in ARGB8888 format. A non-positive size does not
+// restrict that dimension.
+unique_surface_ptr fit_surface(unique_surface_ptr s, vec max_size);
+
+// Decode and fit in one step. If libjpeg is available, JPEG images are already
+// scaled down while decoding, which avoids allocating the full image.
+unique_surface_ptr load_fitted_surface_from_file(std::string const & filename, vec max_size);
+unique_surface_ptr load_fitted_surface_from_memory(std::byte const * data, std::size_t size, vec max_size);
+
+#endif
+
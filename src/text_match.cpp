@@ -0,0 +1,208 @@
+// SPDX-FileCopyrightText: Moritz Bruder <muesli4 at gmail dot com>
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define USE_SSE2
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define USE_NEON
+#endif
+
+#include "text_match.hpp"
+
+bool is_ascii(std::string_view s)
+{
+    char const * p = s.data();
+    std::size_t n = s.size();
+
+#if defined(USE_SSE2)
+    __m128i any = _mm_setzero_si128();
+    for (; n >= 16; n -= 16, p += 16)
+        any = _mm_or_si128(any, _mm_loadu_si128(reinterpret_cast<__m128i const *>(p)));
+    if (_mm_movemask_epi8(any) != 0)
+        return false;
+#elif defined(USE_NEON)
+    uint8x16_t any = vdupq_n_u8(0);
+    for (; n >= 16; n -= 16, p += 16)
+        any = vorrq_u8(any, vld1q_u8(reinterpret_cast<std::uint8_t const *>(p)));
+    uint8x8_t const half = vorr_u8(vget_low_u8(any), vget_high_u8(any));
+    if ((vget_lane_u64(vreinterpret_u64_u8(half), 0) & 0x8080808080808080u) != 0)
+        return false;
+#endif
+
+    for (; n > 0; --n, ++p)
+    {
+        if (static_cast<unsigned char>(*p) >= 0x80)
+            return false;
+    }
+    return true;
+}
+
+std::string ascii_to_lower(std::string_view s)
+{
+    std::string result(s.size(), '\0');
+    char const * src = s.data();
+    char * dst = result.data();
+    std::size_t n = s.size();
+
+#if defined(USE_SSE2)
+    // Bytes of 0x80 and above are negative and therefore never in range.
+    __m128i const before_a = _mm_set1_epi8('A' - 1);
+    __m128i const after_z = _mm_set1_epi8('Z' + 1);
+    __m128i const case_bit = _mm_set1_epi8(0x20);
+    for (; n >= 16; n -= 16, src += 16, dst += 16)
+    {
+        __m128i const v = _mm_loadu_si128(reinterpret_cast<__m128i const *>(src));
+        __m128i const is_upper = _mm_and_si128(_mm_cmpgt_epi8(v, before_a), _mm_cmplt_epi8(v, after_z));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst), _mm_or_si128(v, _mm_and_si128(is_upper, case_bit)));
+    }
+#elif defined(USE_NEON)
+    uint8x16_t const a = vdupq_n_u8('A');
+    uint8x16_t const z = vdupq_n_u8('Z');
+    uint8x16_t const case_bit = vdupq_n_u8(0x20);
+    for (; n >= 16; n -= 16, src += 16, dst += 16)
+    {
+        uint8x16_t const v = vld1q_u8(reinterpret_cast<std::uint8_t const *>(src));
+        uint8x16_t const is_upper = vandq_u8(vcgeq_u8(v, a), vcleq_u8(v, z));
+        vst1q_u8(reinterpret_cast<std::uint8_t *>(dst), vorrq_u8(v, vandq_u8(is_upper, case_bit)));
+    }
+#endif
+
+    for (; n > 0; --n, ++src, ++dst)
+    {
+        *dst = (*src >= 'A' && *src <= 'Z') ? static_cast<char>(*src | 0x20) : *src;
+    }
+    return result;
+}
+
+#if defined(USE_SSE2) || defined(USE_NEON)
+
+static int count_trailing_zeros(std::uint64_t x)
+{
+    return __builtin_ctzll(x);
+}
+
+// Compares the first and the last byte of the needle with 16 positions at
+// once, only candidates are compared completely.
+static std::size_t find_substring_vectorized(std::string_view haystack, std::string_view needle, std::size_t offset)
+{
+    std::size_t const m = needle.size();
+    char const * h = haystack.data();
+
+#if defined(USE_SSE2)
+    __m128i const first = _mm_set1_epi8(needle.front());
+    __m128i const last = _mm_set1_epi8(needle.back());
+#else
+    uint8x16_t const first = vdupq_n_u8(static_cast<std::uint8_t>(needle.front()));
+    uint8x16_t const last = vdupq_n_u8(static_cast<std::uint8_t>(needle.back()));
+#endif
+
+    std::size_t i = offset;
+    for (; i + m - 1 + 16 <= haystack.size(); i += 16)
+    {
+#if defined(USE_SSE2)
+        __m128i const block_first = _mm_loadu_si128(reinterpret_cast<__m128i const *>(h + i));
+        __m128i const block_last = _mm_loadu_si128(reinterpret_cast<__m128i const *>(h + i + m - 1));
+        __m128i const eq = _mm_and_si128(_mm_cmpeq_epi8(first, block_first), _mm_cmpeq_epi8(last, block_last));
+        std::uint64_t mask = static_cast<std::uint32_t>(_mm_movemask_epi8(eq));
+        int const bits_per_byte = 1;
+#else
+        uint8x16_t const block_first = vld1q_u8(reinterpret_cast<std::uint8_t const *>(h + i));
+        uint8x16_t const block_last = vld1q_u8(reinterpret_cast<std::uint8_t const *>(h + i + m - 1));
+        uint8x16_t const eq = vandq_u8(vceqq_u8(first, block_first), vceqq_u8(last, block_last));
+        // There is no movemask, narrowing leaves 4 bits per byte.
+        std::uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(eq), 4)), 0);
+        int const bits_per_byte = 4;
+#endif
+
+        while (mask != 0)
+        {
+            std::size_t const candidate = i + count_trailing_zeros(mask) / bits_per_byte;
+            if (m <= 2 || std::memcmp(h + candidate + 1, needle.data() + 1, m - 2) == 0)
+                return candidate;
+
+#if defined(USE_SSE2)
+            mask &= mask - 1;
+#else
+            mask &= ~(std::uint64_t(0xf) << (count_trailing_zeros(mask) & ~3));
+#endif
+        }
+    }
+
+    return haystack.find(needle, i);
+}
+
+#endif
+
+std::size_t find_substring(std::string_view haystack, std::string_view needle, std::size_t offset)
+{
+#if defined(USE_SSE2) || defined(USE_NEON)
+    if (needle.size() > 1 && offset <= haystack.size())
+        return find_substring_vectorized(haystack, needle, offset);
+#endif
+
+    // memchr is vectorized already
+    return haystack.find(needle, offset);
+}
+
+fuzzy_pattern::fuzzy_pattern(std::string_view pattern)
+    : _masks{}
+    , _size(std::min<std::size_t>(pattern.size(), 64))
+{
+    for (std::size_t i = 0; i < _size; ++i)
+        _masks[static_cast<unsigned char>(pattern[i])] |= std::uint64_t(1) << i;
+}
+
+unsigned int fuzzy_pattern::distance(std::string_view text) const
+{
+    if (_size == 0)
+        return 0;
+
+    // Vertical deltas of the current column of the dynamic programming
+    // matrix. The top row is zero, so a match may start anywhere.
+    std::uint64_t vp = ~std::uint64_t(0);
+    std::uint64_t vn = 0;
+    std::uint64_t d0 = 0;
+    std::uint64_t prev_eq = 0;
+    std::uint64_t const last = std::uint64_t(1) << (_size - 1);
+
+    unsigned int score = _size;
+    unsigned int best = score;
+    for (char c : text)
+    {
+        std::uint64_t const eq = _masks[static_cast<unsigned char>(c)];
+        std::uint64_t const tc = ((~d0 & eq) << 1) & prev_eq;
+        d0 = (((eq & vp) + vp) ^ vp) | eq | vn | tc;
+        std::uint64_t const hp = vn | ~(d0 | vp);
+        std::uint64_t const hn = vp & d0;
+
+        if (hp & last)
+            score++;
+        else if (hn & last)
+        {
+            score--;
+            if (score < best)
+            {
+                best = score;
+                if (best == 0)
+                    break;
+            }
+        }
+
+        vp = (hn << 1) | ~(d0 | (hp << 1));
+        vn = d0 & (hp << 1);
+        prev_eq = eq;
+    }
+    return best;
+}
+
+std::size_t fuzzy_pattern::size() const
+{
+    return _size;
+}
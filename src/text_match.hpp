@@ -0,0 +1,43 @@
+// SPDX-FileCopyrightText: Moritz Bruder <muesli4 at gmail dot com>
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// Byte string helpers for searching, vectorized with SSE2 or NEON where
+// available.
+
+bool is_ascii(std::string_view s);
+
+// Only changes the letters A to Z.
+std::string ascii_to_lower(std::string_view s);
+
+// Position of the first occurrence of the needle at or after the offset, or
+// std::string_view::npos.
+std::size_t find_substring(std::string_view haystack, std::string_view needle, std::size_t offset = 0);
+
+// A pattern prepared for approximate matching with the bit-parallel algorithm
+// of Myers, extended by Hyyrö to count a transposition of two adjacent bytes
+// as one edit. Only the first 64 bytes of the pattern are used.
+struct fuzzy_pattern
+{
+    fuzzy_pattern(std::string_view pattern);
+
+    // The smallest edit distance between the pattern and any substring of the
+    // text. Stops at an exact match.
+    unsigned int distance(std::string_view text) const;
+
+    std::size_t size() const;
+
+    private:
+
+    // for every byte, the pattern positions it occurs at
+    std::array<std::uint64_t, 256> _masks;
+    std::size_t _size;
+};
@@ -0,0 +1,92 @@
+// SPDX-FileCopyrightText: Moritz Bruder <muesli4 at gmail dot com>
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include "worker_pool.hpp"
+
+worker_pool::worker_pool(unsigned int num_threads)
+    : _run(true)
+    , _job(nullptr)
+    , _num_chunks(0)
+    , _job_generation(0)
+    , _next_chunk(0)
+    , _active(0)
+{
+    _threads.reserve(num_threads);
+    for (unsigned int i = 0; i < num_threads; ++i)
+        _threads.emplace_back(&worker_pool::work, this);
+}
+
+worker_pool::~worker_pool()
+{
+    {
+        std::scoped_lock lock(_mutex);
+        _run = false;
+    }
+    _job_cv.notify_all();
+
+    for (auto & t : _threads)
+        t.join();
+}
+
+unsigned int worker_pool::concurrency() const
+{
+    return _threads.size() + 1;
+}
+
+void worker_pool::run(std::size_t num_chunks, std::function<void(std::size_t)> const & f)
+{
+    {
+        std::scoped_lock lock(_mutex);
+        _job = &f;
+        _num_chunks = num_chunks;
+        _next_chunk = 0;
+        _job_generation++;
+    }
+    _job_cv.notify_all();
+
+    process_chunks(f, num_chunks);
+
+    // Chunks may still be processed by other threads.
+    std::unique_lock lock(_mutex);
+    _done_cv.wait(lock, [this](){ return _active == 0; });
+    _job = nullptr;
+}
+
+void worker_pool::work()
+{
+    unsigned int seen_generation = 0;
+
+    std::unique_lock lock(_mutex);
+    while (true)
+    {
+        _job_cv.wait(lock, [&](){ return !_run || _job_generation != seen_generation; });
+        if (!_run)
+            break;
+
+        seen_generation = _job_generation;
+
+        // The job might be over before this thread woke up.
+        if (_job == nullptr)
+            continue;
+
+        auto const & f = *_job;
+        std::size_t const num_chunks = _num_chunks;
+        _active++;
+        lock.unlock();
+
+        process_chunks(f, num_chunks);
+
+        lock.lock();
+        _active--;
+        if (_active == 0)
+            _done_cv.notify_all();
+    }
+}
+
+void worker_pool::process_chunks(std::function<void(std::size_t)> const & f, std::size_t num_chunks)
+{
+    std::size_t chunk;
+    while ((chunk = _next_chunk++) < num_chunks)
+        f(chunk);
+}
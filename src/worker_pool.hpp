@@ -0,0 +1,49 @@
+// SPDX-FileCopyrightText: Moritz Bruder <muesli4 at gmail dot com>
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed set of threads that process chunks of one job at a time. The calling
+// thread takes part, so jobs are completed even without any thread.
+struct worker_pool
+{
+    worker_pool(unsigned int num_threads);
+    ~worker_pool();
+
+    // number of threads that work on a job, including the calling one
+    unsigned int concurrency() const;
+
+    // Calls the function for every chunk in [0, num_chunks) and returns once
+    // all are done. Only one thread may run jobs at a time.
+    void run(std::size_t num_chunks, std::function<void(std::size_t)> const & f);
+
+    private:
+
+    void work();
+    void process_chunks(std::function<void(std::size_t)> const & f, std::size_t num_chunks);
+
+    std::mutex _mutex;
+    std::condition_variable _job_cv;
+    std::condition_variable _done_cv;
+    bool _run;
+
+    // the current job
+    std::function<void(std::size_t)> const * _job;
+    std::size_t _num_chunks;
+    unsigned int _job_generation;
+    std::atomic<std::size_t> _next_chunk;
+
+    // threads working on the current job
+    unsigned int _active;
+
+    std::vector<std::thread> _threads;
+};